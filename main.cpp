@@ -7,130 +7,5043 @@
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <bit>
+#include <random>
+#include <string_view>
+#include <deque>
+#include <coroutine>
+#include <utility>
+#include <atomic>
+#include <optional>
+#include <variant>
+#include <exception>
+#include <type_traits>
+#include <limits>
+#include <unordered_map>
+#include <array>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <ctime>
+#include <cstdlib>
+#include <tuple>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <typeinfo>
+#include <ostream>
+#include <iomanip>
+#include <fstream>
+#include <future>
+#include <span>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TIMERS_HAS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TIMERS_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TIMERS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define TIMERS_ALWAYS_INLINE __forceinline
+#else
+#define TIMERS_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TIMERS_HAS_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#define TIMERS_HAS_LINUX 1
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <linux/futex.h>
+#endif
+
+// Static tracepoints for perf, bpftrace and friends. A probe is a single nop until something attaches to it.
+#if defined(__has_include) && !defined(TIMERS_NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#define TIMERS_HAS_USDT 1
+#include <sys/sdt.h>
+#endif
+#endif
+
+#if defined(TIMERS_HAS_USDT)
+#define TIMERS_PROBE(name, timer, generation) DTRACE_PROBE2(timers, name, timer, generation)
+#else
+#define TIMERS_PROBE(name, timer, generation) ((void)0)
+#endif
 
 using namespace std::chrono_literals;
 
-class TimersManager {
-public:
-	using TimerCallback = std::function<void()>;
+namespace heap_detail {
+	using Tick = std::int64_t;
+	// Deadline relative to an epoch in units of a resolution, see CompactTimerHeap
+	using CompactTick = std::uint32_t;
+
+	// Index of the first smallest deadline among `count` consecutive children
+	template <typename Deadline>
+	inline std::size_t minChildScalar(const Deadline *deadlines, std::size_t count) {
+		std::size_t best = 0;
+		for (std::size_t i = 1; i < count; ++i) {
+			if (deadlines[i] < deadlines[best]) {
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	template <typename Deadline>
+	inline std::size_t minChildOf8Scalar(const Deadline *deadlines) {
+		return minChildScalar(deadlines, 8);
+	}
+
+#if defined(TIMERS_HAS_X86)
+	// AVX2 has no 64-bit min, so it is built from a compare and a blend
+	TIMERS_TARGET_AVX2 inline __m256i min64(__m256i a, __m256i b) {
+		return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+	}
+
+	TIMERS_TARGET_AVX2 inline std::size_t minChildOf8Avx2(const Tick *deadlines) {
+		const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(deadlines));
+		const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(deadlines + 4));
+
+		// Reduce to the minimum broadcast in every lane
+		__m256i m = min64(lo, hi);
+		m = min64(m, _mm256_permute4x64_epi64(m, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = min64(m, _mm256_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+
+		// Find the first lane holding it, same tie-breaking as the scalar version
+		const unsigned maskLo = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, m))));
+		const unsigned maskHi = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, m))));
+
+		return static_cast<std::size_t>(std::countr_zero(maskLo | (maskHi << 4)));
+	}
+
+	// With 32-bit deadlines all 8 children fit in one register and there is a native unsigned min
+	TIMERS_TARGET_AVX2 inline std::size_t minChildOf8Avx2Compact(const CompactTick *deadlines) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(deadlines));
+
+		__m256i m = _mm256_min_epu32(v, _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm256_min_epu32(m, _mm256_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm256_min_epu32(m, _mm256_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, m))));
+		return static_cast<std::size_t>(std::countr_zero(mask));
+	}
+
+	inline bool cpuHasAvx2() {
+		int regs[4]{};
+#if defined(_MSC_VER)
+		__cpuid(regs, 1);
+#else
+		__cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		// The OS has to save the YMM registers (OSXSAVE + XCR0 bits 1 and 2)
+		const bool osxsave = (regs[2] & (1 << 27)) != 0;
+		const bool avx = (regs[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx) {
+			return false;
+		}
+
+		std::uint32_t xcr0Lo = 0;
+#if defined(_MSC_VER)
+		xcr0Lo = static_cast<std::uint32_t>(_xgetbv(0));
+#else
+		std::uint32_t xcr0Hi = 0;
+		__asm__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+#endif
+		if ((xcr0Lo & 0x6) != 0x6) {
+			return false;
+		}
+
+#if defined(_MSC_VER)
+		__cpuidex(regs, 7, 0);
+#else
+		__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		return (regs[1] & (1 << 5)) != 0;
+	}
+#else
+	inline bool cpuHasAvx2() {
+		return false;
+	}
+#endif
+
+	// How a heap finds the smallest of 8 children
+	enum class MinChildKernel {
+		Scalar,
+		Avx2
+	};
+
+	// Picked once at runtime, the binary itself doesn't require AVX2. With 64-bit deadlines the
+	// compare and blend reduction measured no faster than the scalar loop, so only 32-bit ones use it.
+	template <typename Deadline>
+	inline MinChildKernel selectMinChildKernel() {
+		return std::is_same_v<Deadline, CompactTick> && cpuHasAvx2() ? MinChildKernel::Avx2 : MinChildKernel::Scalar;
+	}
+}
+
+// Array growing one fixed-size chunk at a time. Growing never moves the stored elements, so a big
+// array doesn't get copied as a whole, and only the small table of chunk pointers ever reallocates.
+// Element i lives at position i + Padding, which lets a caller line groups of elements up with the
+// chunk boundaries.
+template <typename T, std::size_t ChunkSize, std::size_t Padding = 0>
+class ChunkedArray {
+	static_assert(std::has_single_bit(ChunkSize) && Padding < ChunkSize);
+
+public:
+	bool empty() const {
+		return m_size == 0;
+	}
+
+	std::size_t size() const {
+		return m_size;
+	}
+
+	T &operator[](std::size_t index) {
+		return slot(index + Padding);
+	}
+
+	const T &operator[](std::size_t index) const {
+		return slot(index + Padding);
+	}
+
+	T &front() {
+		return (*this)[0];
+	}
+
+	const T &front() const {
+		return (*this)[0];
+	}
+
+	T &back() {
+		return (*this)[m_size - 1];
+	}
+
+	// The chunks allocated here are kept when the array shrinks
+	void reserve(std::size_t capacity) {
+		m_reservedChunks = std::max(m_reservedChunks, (capacity + Padding + ChunkSize - 1) / ChunkSize);
+		while (m_chunks.size() < m_reservedChunks) {
+			m_chunks.push_back(std::make_unique<T[]>(ChunkSize));
+		}
+	}
+
+	void push_back(T value) {
+		const std::size_t position = m_size + Padding;
+		if (position / ChunkSize == m_chunks.size()) {
+			m_chunks.push_back(std::make_unique<T[]>(ChunkSize));
+		}
+
+		slot(position) = std::move(value);
+		++m_size;
+	}
+
+	void pop_back() {
+		--m_size;
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			slot(m_size + Padding) = T{};
+		}
+
+		// One spare chunk stays, so a size going back and forth over a boundary doesn't allocate each time
+		const std::size_t usedChunks = (m_size + Padding) / ChunkSize + 1;
+		if (m_chunks.size() > std::max(usedChunks + 1, m_reservedChunks)) {
+			m_chunks.pop_back();
+		}
+	}
+
+private:
+	T &slot(std::size_t position) {
+		return m_chunks[position / ChunkSize][position % ChunkSize];
+	}
+
+	const T &slot(std::size_t position) const {
+		return m_chunks[position / ChunkSize][position % ChunkSize];
+	}
+
+	std::vector<std::unique_ptr<T[]>> m_chunks;
+	std::size_t m_size{ 0 };
+	std::size_t m_reservedChunks{ 0 };
+};
+
+// 8-ary min-heap keyed by deadline. The deadlines are packed in their own array so all children
+// of a node share a cache line and can be compared with vector loads, the payloads just follow
+// the moves.
+// Payloads pointing to something with a `heapIndex` member get it updated on every move, which
+// allows erasing them from the middle of the heap.
+// Both arrays are chunked, an insert never copies the whole heap. The root sits Arity - 1 slots into
+// the first chunk so the children of a node, which start at a multiple of Arity, never straddle two
+// chunks and are still read with plain vector loads.
+template <typename Payload, typename Deadline = heap_detail::Tick>
+class TimerHeap {
+public:
+	using Tick = Deadline;
+	using MinChildKernel = heap_detail::MinChildKernel;
+
+	static constexpr std::size_t Arity = 8;
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	// 32 KiB of 64-bit deadlines
+	static constexpr std::size_t ChunkSize = 4096;
+
+	explicit TimerHeap(MinChildKernel kernel = s_defaultKernel)
+		: m_kernel(kernel) {
+
+	}
+
+	bool empty() const {
+		return m_deadlines.empty();
+	}
+
+	std::size_t size() const {
+		return m_deadlines.size();
+	}
+
+	void reserve(std::size_t capacity) {
+		m_deadlines.reserve(capacity);
+		m_payloads.reserve(capacity);
+	}
+
+	Tick topDeadline() const {
+		return m_deadlines.front();
+	}
+
+	Tick deadlineAt(std::size_t index) const {
+		return m_deadlines[index];
+	}
+
+	const Payload &payloadAt(std::size_t index) const {
+		return m_payloads[index];
+	}
+
+	const Payload &top() const {
+		return m_payloads.front();
+	}
+
+	// Visits the elements in storage order
+	template <typename Visitor>
+	void forEach(Visitor &&visitor) const {
+		for (std::size_t i = 0; i < m_deadlines.size(); ++i) {
+			visitor(m_deadlines[i], m_payloads[i]);
+		}
+	}
+
+	// Rewrites every deadline in place. A non-decreasing transform keeps the heap order, anything
+	// else has to be followed by heapify().
+	template <typename Transform>
+	void transformDeadlines(Transform &&transform) {
+		for (std::size_t i = 0; i < m_deadlines.size(); ++i) {
+			m_deadlines[i] = transform(m_deadlines[i], m_payloads[i]);
+		}
+	}
+
+	// Adds without restoring the heap order, heapify() has to follow
+	void append(Tick deadline, Payload payload) {
+		m_deadlines.push_back(deadline);
+		m_payloads.push_back(std::move(payload));
+	}
+
+	// Bottom-up heap construction, O(n) for the whole array
+	void heapify() {
+		if (m_deadlines.size() < 2) {
+			for (std::size_t i = 0; i < m_payloads.size(); ++i) {
+				setHeapIndex(m_payloads[i], i);
+			}
+			return;
+		}
+
+		// Leaves only need their index, the rest get it while sifting
+		const std::size_t lastParent = (m_deadlines.size() - 2) / Arity;
+		for (std::size_t i = lastParent + 1; i < m_payloads.size(); ++i) {
+			setHeapIndex(m_payloads[i], i);
+		}
+
+		for (std::size_t i = lastParent + 1; i-- > 0;) {
+			siftDown(i, m_deadlines[i], std::move(m_payloads[i]));
+		}
+	}
+
+	void push(Tick deadline, Payload payload) {
+		m_deadlines.push_back(deadline);
+		m_payloads.push_back(std::move(payload));
+		siftUp(m_deadlines.size() - 1);
+	}
+
+	Payload pop() {
+		Payload top = std::move(m_payloads.front());
+
+		const Tick lastDeadline = m_deadlines.back();
+		Payload lastPayload = std::move(m_payloads.back());
+		m_deadlines.pop_back();
+		m_payloads.pop_back();
+
+		if (!m_deadlines.empty()) {
+			siftDown(0, lastDeadline, std::move(lastPayload));
+		}
+
+		setHeapIndex(top, npos);
+		return top;
+	}
+
+	// Moves the element at `index` to a new deadline
+	void update(std::size_t index, Tick deadline) {
+		Payload payload = std::move(m_payloads[index]);
+
+		if (index > 0 && deadline < m_deadlines[(index - 1) / Arity]) {
+			place(index, deadline, std::move(payload));
+			siftUp(index);
+		}
+		else {
+			siftDown(index, deadline, std::move(payload));
+		}
+	}
+
+	Payload erase(std::size_t index) {
+		Payload erased = std::move(m_payloads[index]);
+
+		const Tick lastDeadline = m_deadlines.back();
+		Payload lastPayload = std::move(m_payloads.back());
+		m_deadlines.pop_back();
+		m_payloads.pop_back();
+
+		// The last element takes the freed place and goes up or down from there
+		if (index < m_deadlines.size()) {
+			if (index > 0 && lastDeadline < m_deadlines[(index - 1) / Arity]) {
+				m_deadlines[index] = lastDeadline;
+				m_payloads[index] = std::move(lastPayload);
+				siftUp(index);
+			}
+			else {
+				siftDown(index, lastDeadline, std::move(lastPayload));
+			}
+		}
+
+		setHeapIndex(erased, npos);
+		return erased;
+	}
+
+private:
+	static void setHeapIndex(Payload &payload, std::size_t index) {
+		if constexpr (requires { payload->heapIndex = index; }) {
+			payload->heapIndex = index;
+		}
+	}
+
+	void place(std::size_t index, Tick deadline, Payload payload) {
+		m_deadlines[index] = deadline;
+		m_payloads[index] = std::move(payload);
+		setHeapIndex(m_payloads[index], index);
+	}
+
+	void siftUp(std::size_t index) {
+		const Tick deadline = m_deadlines[index];
+		Payload payload = std::move(m_payloads[index]);
+
+		while (index > 0) {
+			const std::size_t parent = (index - 1) / Arity;
+			if (m_deadlines[parent] <= deadline) {
+				break;
+			}
+
+			place(index, m_deadlines[parent], std::move(m_payloads[parent]));
+			index = parent;
+		}
+
+		place(index, deadline, std::move(payload));
+	}
+
+	// Moves the hole at `index` down until `deadline` fits in it. The kernel is checked once per sift
+	// and each version has its search inlined, rather than an indirect call on every level.
+	void siftDown(std::size_t index, Tick deadline, Payload payload) {
+#if defined(TIMERS_HAS_X86)
+		if (m_kernel == MinChildKernel::Avx2) {
+			siftDownAvx2(index, deadline, std::move(payload));
+			return;
+		}
+#endif
+		siftDownWith<MinChildKernel::Scalar>(index, deadline, std::move(payload));
+	}
+
+#if defined(TIMERS_HAS_X86)
+	TIMERS_TARGET_AVX2 void siftDownAvx2(std::size_t index, Tick deadline, Payload payload) {
+		siftDownWith<MinChildKernel::Avx2>(index, deadline, std::move(payload));
+	}
+#endif
+
+	template <MinChildKernel Kernel>
+	TIMERS_ALWAYS_INLINE void siftDownWith(std::size_t index, Tick deadline, Payload payload) {
+		const std::size_t size = m_deadlines.size();
+
+		while (true) {
+			const std::size_t firstChild = index * Arity + 1;
+			if (firstChild >= size) {
+				break;
+			}
+
+			const std::size_t childCount = std::min(Arity, size - firstChild);
+			const std::size_t child = firstChild + (childCount == Arity
+				? minChildOf8<Kernel>(&m_deadlines[firstChild])
+				: heap_detail::minChildScalar<Deadline>(&m_deadlines[firstChild], childCount));
+
+			if (m_deadlines[child] >= deadline) {
+				break;
+			}
+
+			place(index, m_deadlines[child], std::move(m_payloads[child]));
+			index = child;
+		}
+
+		place(index, deadline, std::move(payload));
+	}
+
+	template <MinChildKernel Kernel>
+	TIMERS_ALWAYS_INLINE static std::size_t minChildOf8(const Tick *deadlines) {
+#if defined(TIMERS_HAS_X86)
+		if constexpr (Kernel == MinChildKernel::Avx2) {
+			if constexpr (std::is_same_v<Deadline, heap_detail::CompactTick>) {
+				return heap_detail::minChildOf8Avx2Compact(deadlines);
+			}
+			else {
+				return heap_detail::minChildOf8Avx2(deadlines);
+			}
+		}
+#endif
+		return heap_detail::minChildOf8Scalar<Deadline>(deadlines);
+	}
+
+private:
+	static inline const MinChildKernel s_defaultKernel = heap_detail::selectMinChildKernel<Deadline>();
+
+	MinChildKernel m_kernel;
+	ChunkedArray<Tick, ChunkSize, Arity - 1> m_deadlines;
+	ChunkedArray<Payload, ChunkSize, Arity - 1> m_payloads;
+};
+
+// TimerHeap with the same interface, storing deadlines as 32-bit ticks of `resolution` nanoseconds
+// after a rolling epoch. That halves the deadline array and puts all 8 children in one vector
+// register. Deadlines are rounded up so nothing fires early, and ones too far out for 32 bits are
+// stored as the largest tick with the exact deadline on the side. advance() moves the epoch along
+// with the clock, so deadlines only overflow if they are more than 3/4 of the range away.
+template <typename Payload>
+class CompactTimerHeap {
+public:
+	using Tick = heap_detail::Tick;
+	using CompactTick = heap_detail::CompactTick;
+
+	static constexpr std::size_t npos = TimerHeap<Payload, CompactTick>::npos;
+
+	explicit CompactTimerHeap(Tick resolution = 100'000, Tick epoch = 0)
+		: m_resolution(std::max<Tick>(resolution, 1))
+		, m_epoch(epoch) {
+
+	}
+
+	bool empty() const {
+		return m_heap.empty();
+	}
+
+	std::size_t size() const {
+		return m_heap.size();
+	}
+
+	void reserve(std::size_t capacity) {
+		m_heap.reserve(capacity);
+	}
+
+	// For an overflowed top this is the earliest deadline it can have, the caller is back before
+	// it and the advance() then sorts the overflowed ones out
+	Tick topDeadline() const {
+		return decode(m_heap.topDeadline());
+	}
+
+	const Payload &top() const {
+		return m_heap.top();
+	}
+
+	template <typename Visitor>
+	void forEach(Visitor &&visitor) const {
+		m_heap.forEach([&](CompactTick tick, const Payload &payload) {
+			visitor(tick == Overflow ? m_overflow.at(payload) : decode(tick), payload);
+		});
+	}
+
+	void append(Tick deadline, Payload payload) {
+		m_heap.append(encode(deadline, payload), std::move(payload));
+	}
+
+	void heapify() {
+		m_heap.heapify();
+	}
+
+	void push(Tick deadline, Payload payload) {
+		m_heap.push(encode(deadline, payload), std::move(payload));
+	}
+
+	Payload pop() {
+		if (m_heap.topDeadline() == Overflow) {
+			m_overflow.erase(m_heap.top());
+		}
+		return m_heap.pop();
+	}
+
+	void update(std::size_t index, Tick deadline) {
+		const Payload &payload = m_heap.payloadAt(index);
+		if (m_heap.deadlineAt(index) == Overflow) {
+			m_overflow.erase(payload);
+		}
+		m_heap.update(index, encode(deadline, payload));
+	}
+
+	Payload erase(std::size_t index) {
+		const bool overflowed = m_heap.deadlineAt(index) == Overflow;
+		Payload erased = m_heap.erase(index);
+		if (overflowed) {
+			m_overflow.erase(erased);
+		}
+		return erased;
+	}
+
+	// Moves the epoch up to `now` once it is a quarter of the range behind. Shifting every tick by
+	// the same amount keeps the order, only the overflowed ones are encoded again and sorted in.
+	void advance(Tick now) {
+		const Tick shift = (now - m_epoch) / m_resolution;
+		if (shift < static_cast<Tick>(Overflow / 4)) {
+			return;
+		}
+
+		m_epoch += shift * m_resolution;
+
+		bool reencoded = false;
+		m_heap.transformDeadlines([&](CompactTick tick, const Payload &payload) -> CompactTick {
+			if (tick != Overflow) {
+				return tick > shift ? static_cast<CompactTick>(tick - shift) : 0;
+			}
+
+			reencoded = true;
+			const Tick deadline = m_overflow.at(payload);
+			const CompactTick encoded = encodeTick(deadline);
+			if (encoded != Overflow) {
+				m_overflow.erase(payload);
+			}
+			return encoded;
+		});
+
+		if (reencoded) {
+			m_heap.heapify();
+		}
+	}
+
+private:
+	static constexpr CompactTick Overflow = std::numeric_limits<CompactTick>::max();
+
+	CompactTick encodeTick(Tick deadline) const {
+		if (deadline <= m_epoch) {
+			return 0;
+		}
+
+		const Tick ticks = (deadline - m_epoch + m_resolution - 1) / m_resolution;
+		return ticks >= static_cast<Tick>(Overflow) ? Overflow : static_cast<CompactTick>(ticks);
+	}
+
+	CompactTick encode(Tick deadline, const Payload &payload) {
+		const CompactTick tick = encodeTick(deadline);
+		if (tick == Overflow) {
+			m_overflow[payload] = deadline;
+		}
+		return tick;
+	}
+
+	Tick decode(CompactTick tick) const {
+		return m_epoch + static_cast<Tick>(tick) * m_resolution;
+	}
+
+	Tick m_resolution;
+	Tick m_epoch;
+	TimerHeap<Payload, CompactTick> m_heap;
+	std::unordered_map<Payload, Tick> m_overflow;
+};
+
+// Chase-Lev work-stealing deque of pointers. The owner pushes and pops at the bottom, any thread may
+// steal from the top. Outgrown buffers are kept until destruction since a thief may still read them.
+template <typename T>
+class WorkStealingDeque {
+public:
+	explicit WorkStealingDeque(std::size_t capacity = 256) {
+		m_retired.push_back(std::make_unique<Buffer>(std::bit_ceil(std::max<std::size_t>(capacity, 2))));
+		m_buffer.store(m_retired.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque &) = delete;
+	WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+	// Owner only
+	void push(T *item) {
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		Buffer *buffer = m_buffer.load(std::memory_order_relaxed);
+
+		if (bottom - top >= static_cast<std::int64_t>(buffer->size())) {
+			buffer = grow(buffer, top, bottom);
+		}
+
+		buffer->put(bottom, item);
+		m_bottom.store(bottom + 1, std::memory_order_release);
+	}
+
+	// Owner only, nullptr when empty
+	T *pop() {
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		Buffer *buffer = m_buffer.load(std::memory_order_relaxed);
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom) {
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		T *item = buffer->get(bottom);
+		if (top == bottom) {
+			// Last item, race the thieves for it
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				item = nullptr;
+			}
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	// Any thread, nullptr when empty or when another thread won the item
+	T *steal() {
+		std::int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom) {
+			return nullptr;
+		}
+
+		T *item = m_buffer.load(std::memory_order_acquire)->get(top);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return item;
+	}
+
+	bool empty() const {
+		return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+	}
+
+private:
+	class Buffer {
+	public:
+		explicit Buffer(std::size_t size)
+			: m_items(size)
+			, m_mask(size - 1) {
+
+		}
+
+		std::size_t size() const {
+			return m_items.size();
+		}
+
+		T *get(std::int64_t index) const {
+			return m_items[static_cast<std::size_t>(index) & m_mask].load(std::memory_order_relaxed);
+		}
+
+		void put(std::int64_t index, T *item) {
+			m_items[static_cast<std::size_t>(index) & m_mask].store(item, std::memory_order_relaxed);
+		}
+
+	private:
+		std::vector<std::atomic<T *>> m_items;
+		std::size_t m_mask;
+	};
+
+	Buffer *grow(Buffer *buffer, std::int64_t top, std::int64_t bottom) {
+		m_retired.push_back(std::make_unique<Buffer>(buffer->size() * 2));
+		Buffer *grown = m_retired.back().get();
+		for (std::int64_t i = top; i < bottom; ++i) {
+			grown->put(i, buffer->get(i));
+		}
+		m_buffer.store(grown, std::memory_order_release);
+		return grown;
+	}
+
+	alignas(64) std::atomic<std::int64_t> m_top{ 0 };
+	alignas(64) std::atomic<std::int64_t> m_bottom{ 0 };
+	std::atomic<Buffer *> m_buffer{ nullptr };
+	std::vector<std::unique_ptr<Buffer>> m_retired;
+};
+
+#if defined(TIMERS_HAS_POSIX)
+// Whole file mapped in memory, either created with a given size or opened read-only
+class MappedFile {
+public:
+	static MappedFile create(const std::filesystem::path &path, std::size_t size) {
+		const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path.string());
+		}
+
+		if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+			const int error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "ftruncate " + path.string());
+		}
+
+		return MappedFile{ fd, size, PROT_READ | PROT_WRITE };
+	}
+
+	static MappedFile openReadOnly(const std::filesystem::path &path) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + path.string());
+		}
+
+		struct stat info {};
+		if (::fstat(fd, &info) != 0) {
+			const int error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "fstat " + path.string());
+		}
+
+		return MappedFile{ fd, static_cast<std::size_t>(info.st_size), PROT_READ };
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	MappedFile(MappedFile &&other) noexcept
+		: m_fd(std::exchange(other.m_fd, -1))
+		, m_data(std::exchange(other.m_data, nullptr))
+		, m_size(std::exchange(other.m_size, 0)) {
+
+	}
+
+	MappedFile &operator=(MappedFile &&) = delete;
+
+	~MappedFile() {
+		if (m_data) {
+			::munmap(m_data, m_size);
+		}
+		if (m_fd >= 0) {
+			::close(m_fd);
+		}
+	}
+
+	std::byte *data() const {
+		return static_cast<std::byte *>(m_data);
+	}
+
+	std::size_t size() const {
+		return m_size;
+	}
+
+	void sync() {
+		if (m_data && ::msync(m_data, m_size, MS_SYNC) != 0) {
+			throw std::system_error(errno, std::generic_category(), "msync");
+		}
+	}
+
+private:
+	MappedFile(int fd, std::size_t size, int protection)
+		: m_fd(fd)
+		, m_size(size) {
+		if (size == 0) {
+			return;
+		}
+
+		void *data = ::mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) {
+			const int error = errno;
+			::close(std::exchange(m_fd, -1));
+			throw std::system_error(error, std::generic_category(), "mmap");
+		}
+		m_data = data;
+	}
+
+	int m_fd{ -1 };
+	void *m_data{ nullptr };
+	std::size_t m_size{ 0 };
+};
+
+// Write-ahead log of durable timers. Appends are buffered and a flusher thread writes them with a
+// single fdatasync per group, so concurrent writers share the cost of a sync. Past the compaction
+// threshold the live timers are written to `<log>.snapshot` and the log starts over.
+class DurableTimerLog {
+public:
+	struct Record {
+		std::uint64_t id{ 0 };
+		// system_clock nanoseconds
+		std::int64_t wallDeadline{ 0 };
+		std::uint32_t typeId{ 0 };
+		std::uint8_t priority{ 0 };
+		std::string payload;
+	};
+
+	struct Options {
+		// How long the flusher lets records pile up before syncing them
+		std::chrono::microseconds groupCommitDelay{ 200 };
+		// Records appended since the last compaction that trigger the next one
+		std::size_t compactionThreshold{ 100'000 };
+	};
+
+	DurableTimerLog(std::filesystem::path path, Options options)
+		: m_path(std::move(path))
+		, m_snapshotPath(m_path.string() + ".snapshot")
+		, m_options(options) {
+		recover();
+
+		m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (m_fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + m_path.string());
+		}
+		// A log created just now must not vanish with its directory entry
+		syncDirectory(m_path);
+
+		m_flusher = std::jthread([this] {
+			flusherLoop();
+		});
+	}
+
+	DurableTimerLog(const DurableTimerLog &) = delete;
+	DurableTimerLog &operator=(const DurableTimerLog &) = delete;
+
+	~DurableTimerLog() {
+		{
+			std::lock_guard lock(m_mtx);
+			m_stopping = true;
+		}
+		m_appendCv.notify_one();
+		m_flusher.join();
+
+		::close(m_fd);
+	}
+
+	// Timers that were live when the previous run stopped
+	std::vector<Record> liveTimers() const {
+		std::lock_guard lock(m_mtx);
+
+		std::vector<Record> records;
+		records.reserve(m_live.size());
+		for (const auto &[id, record] : m_live) {
+			records.push_back(record);
+		}
+		return records;
+	}
+
+	std::uint64_t allocateId() {
+		return m_nextId.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Both return the sequence number to pass to waitDurable()
+	std::uint64_t appendInsert(Record record) {
+		std::lock_guard lock(m_mtx);
+
+		encode(m_buffer, RecordType::Insert, record);
+		m_live[record.id] = std::move(record);
+		return appended();
+	}
+
+	std::uint64_t appendRemove(std::uint64_t id) {
+		std::lock_guard lock(m_mtx);
+
+		Record removed;
+		removed.id = id;
+		encode(m_buffer, RecordType::Remove, removed);
+		m_live.erase(id);
+		return appended();
+	}
+
+	void waitDurable(std::uint64_t sequence) {
+		std::unique_lock lock(m_mtx);
+		m_durableCv.wait(lock, [&] { return m_durable >= sequence; });
+	}
+
+	std::uint64_t syncCount() const {
+		return m_syncs.load(std::memory_order_relaxed);
+	}
+
+private:
+	enum class RecordType : std::uint8_t {
+		Insert = 1,
+		Remove = 2
+	};
+
+	// Followed by the payload. The checksum covers everything after it, a torn tail fails it.
+	struct RecordHeader {
+		std::uint32_t checksum;
+		RecordType type;
+		std::uint8_t priority;
+		std::uint16_t reserved;
+		std::uint32_t typeId;
+		std::uint32_t payloadSize;
+		std::uint64_t id;
+		std::int64_t wallDeadline;
+	};
+
+	static std::uint32_t checksum(const std::byte *data, std::size_t size, std::uint32_t hash = 2166136261u) {
+		// FNV-1a
+		for (std::size_t i = 0; i < size; ++i) {
+			hash = (hash ^ static_cast<std::uint32_t>(data[i])) * 16777619u;
+		}
+		return hash;
+	}
+
+	static std::size_t recordSize(const Record &record) {
+		return sizeof(RecordHeader) + record.payload.size();
+	}
+
+	static void encode(std::byte *out, RecordType type, const Record &record) {
+		RecordHeader header{ 0, type, record.priority, 0, record.typeId, static_cast<std::uint32_t>(record.payload.size()), record.id, record.wallDeadline };
+		std::memcpy(out + sizeof(header), record.payload.data(), record.payload.size());
+
+		const std::size_t checked = sizeof(header) - sizeof(header.checksum);
+		header.checksum = checksum(out + sizeof(header), record.payload.size(), checksum(reinterpret_cast<const std::byte *>(&header) + sizeof(header.checksum), checked));
+		std::memcpy(out, &header, sizeof(header));
+	}
+
+	static void encode(std::vector<std::byte> &buffer, RecordType type, const Record &record) {
+		const std::size_t offset = buffer.size();
+		buffer.resize(offset + recordSize(record));
+		encode(buffer.data() + offset, type, record);
+	}
+
+	// Applies the valid records of `data` to `live`, returns the size of the valid prefix
+	static std::size_t replay(const std::byte *data, std::size_t size, std::unordered_map<std::uint64_t, Record> &live) {
+		std::size_t offset = 0;
+
+		while (size - offset >= sizeof(RecordHeader)) {
+			RecordHeader header{};
+			std::memcpy(&header, data + offset, sizeof(header));
+
+			if (size - offset - sizeof(header) < header.payloadSize) {
+				break;
+			}
+
+			const std::byte *payload = data + offset + sizeof(header);
+			const std::size_t checked = sizeof(header) - sizeof(header.checksum);
+			if (header.checksum != checksum(payload, header.payloadSize, checksum(data + offset + sizeof(header.checksum), checked))) {
+				break;
+			}
+
+			if (header.type == RecordType::Insert) {
+				live[header.id] = Record{ header.id, header.wallDeadline, header.typeId, header.priority, std::string(reinterpret_cast<const char *>(payload), header.payloadSize) };
+			}
+			else {
+				live.erase(header.id);
+			}
+
+			offset += sizeof(header) + header.payloadSize;
+		}
+
+		return offset;
+	}
+
+	// Snapshot first, then the log on top. Replaying is idempotent, so a crash between writing a
+	// snapshot and truncating the log only replays a few records twice.
+	void recover() {
+		if (std::filesystem::exists(m_snapshotPath)) {
+			const MappedFile snapshot = MappedFile::openReadOnly(m_snapshotPath);
+			replay(snapshot.data(), snapshot.size(), m_live);
+		}
+
+		if (std::filesystem::exists(m_path)) {
+			std::size_t validSize = 0;
+			std::size_t fileSize = 0;
+
+			{
+				const MappedFile log = MappedFile::openReadOnly(m_path);
+				fileSize = log.size();
+				validSize = replay(log.data(), log.size(), m_live);
+			}
+
+			// Drop a record torn by a crash so new appends don't land behind it
+			if (validSize != fileSize) {
+				std::filesystem::resize_file(m_path, validSize);
+			}
+		}
+
+		std::uint64_t maxId = 0;
+		for (const auto &[id, record] : m_live) {
+			maxId = std::max(maxId, id);
+		}
+		m_nextId.store(maxId + 1, std::memory_order_relaxed);
+	}
+
+	std::uint64_t appended() {
+		++m_recordsSinceCompaction;
+		m_appendCv.notify_one();
+		return ++m_appended;
+	}
+
+	static void writeAll(int fd, const std::byte *data, std::size_t size) {
+		while (size > 0) {
+			const ssize_t written = ::write(fd, data, size);
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "write timers log");
+			}
+
+			data += written;
+			size -= static_cast<std::size_t>(written);
+		}
+	}
+
+	// Makes a creation or rename of `file` durable, fdatasync() of the file alone doesn't cover its name
+	static void syncDirectory(const std::filesystem::path &file) {
+		const std::filesystem::path directory = file.has_parent_path() ? file.parent_path() : std::filesystem::path{ "." };
+		const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open " + directory.string());
+		}
+
+		const int rc = ::fsync(fd);
+		const int error = errno;
+		::close(fd);
+		if (rc != 0) {
+			throw std::system_error(error, std::generic_category(), "fsync " + directory.string());
+		}
+	}
+
+	// Errors are fatal here on purpose, acknowledging a timer that isn't on disk would be worse
+	void flusherLoop() {
+		std::unique_lock lock(m_mtx);
+
+		while (true) {
+			m_appendCv.wait(lock, [this] { return m_appended != m_durable || m_stopping; });
+			if (m_appended == m_durable) {
+				break;
+			}
+
+			// Give concurrent writers a chance to join this sync
+			if (!m_stopping && m_options.groupCommitDelay.count() > 0) {
+				m_appendCv.wait_for(lock, m_options.groupCommitDelay, [this] { return m_stopping; });
+			}
+
+			std::vector<std::byte> buffer;
+			buffer.swap(m_buffer);
+			const std::uint64_t sequence = m_appended;
+
+			lock.unlock();
+			writeAll(m_fd, buffer.data(), buffer.size());
+			if (::fdatasync(m_fd) != 0) {
+				throw std::system_error(errno, std::generic_category(), "fdatasync timers log");
+			}
+			m_syncs.fetch_add(1, std::memory_order_relaxed);
+			lock.lock();
+
+			m_durable = sequence;
+
+			if (m_recordsSinceCompaction >= m_options.compactionThreshold) {
+				compact(lock);
+			}
+
+			m_durableCv.notify_all();
+		}
+	}
+
+	// Called on the flusher with m_mtx held, which is released while the snapshot is written so
+	// appends go on meanwhile. The log only holds records up to m_durable, all of them in the copied
+	// live set. Records appended after the copy stay buffered and reach the log after the truncation.
+	void compact(std::unique_lock<std::mutex> &lock) {
+		std::vector<Record> live;
+		live.reserve(m_live.size());
+		std::size_t size = 0;
+		for (const auto &[id, record] : m_live) {
+			live.push_back(record);
+			size += recordSize(record);
+		}
+		m_recordsSinceCompaction = 0;
+
+		lock.unlock();
+
+		std::filesystem::path tempPath = m_snapshotPath;
+		tempPath += ".tmp";
+
+		{
+			MappedFile snapshot = MappedFile::create(tempPath, size);
+			std::byte *out = snapshot.data();
+			for (const Record &record : live) {
+				encode(out, RecordType::Insert, record);
+				out += recordSize(record);
+			}
+			snapshot.sync();
+		}
+
+		std::filesystem::rename(tempPath, m_snapshotPath);
+		// The new snapshot has to be in place for good before the log it replaces is emptied
+		syncDirectory(m_snapshotPath);
+
+		// Only the flusher writes to the log, nothing lands in it while it is truncated
+		if (::ftruncate(m_fd, 0) != 0 || ::fdatasync(m_fd) != 0) {
+			throw std::system_error(errno, std::generic_category(), "truncate timers log");
+		}
+
+		lock.lock();
+	}
+
+private:
+	const std::filesystem::path m_path;
+	const std::filesystem::path m_snapshotPath;
+	const Options m_options;
+	int m_fd{ -1 };
+
+	mutable std::mutex m_mtx;
+	std::condition_variable m_appendCv;
+	std::condition_variable m_durableCv;
+	std::vector<std::byte> m_buffer;
+	std::uint64_t m_appended{ 0 };
+	std::uint64_t m_durable{ 0 };
+	std::size_t m_recordsSinceCompaction{ 0 };
+	std::unordered_map<std::uint64_t, Record> m_live;
+	bool m_stopping{ false };
+
+	std::atomic<std::uint64_t> m_nextId{ 1 };
+	std::atomic<std::uint64_t> m_syncs{ 0 };
+	std::jthread m_flusher;
+};
+#endif
+
+// Keeps the latest lifecycle events of the timers in memory and writes them in the Chrome trace
+// event format, to be opened in chrome://tracing or Perfetto. Older events are overwritten.
+class TimerTracer {
+public:
+	enum class Event : std::uint8_t {
+		Insert,
+		Dequeue,
+		Cancel,
+		CallbackStart,
+		CallbackEnd
+	};
+
+	explicit TimerTracer(std::size_t capacity)
+		: m_entries(std::max<std::size_t>(capacity, 1)) {
+
+	}
+
+	void record(Event event, const void *timer, std::uint64_t generation) {
+		const auto now = std::chrono::steady_clock::now();
+		const std::uint32_t thread = threadIndex();
+
+		std::lock_guard lock(m_mtx);
+		m_entries[m_recorded % m_entries.size()] = Entry{ now, timer, generation, thread, event };
+		++m_recorded;
+	}
+
+	void writeChromeTrace(std::ostream &out) const {
+		std::lock_guard lock(m_mtx);
+
+		const std::size_t count = std::min<std::uint64_t>(m_recorded, m_entries.size());
+		const std::size_t first = m_recorded - count;
+		const auto origin = count ? m_entries[first % m_entries.size()].time : std::chrono::steady_clock::time_point{};
+
+		out << "{\"traceEvents\":[";
+		for (std::size_t i = 0; i < count; ++i) {
+			const Entry &entry = m_entries[(first + i) % m_entries.size()];
+			const double timestamp = std::chrono::duration<double, std::micro>(entry.time - origin).count();
+
+			// Pending time is an async span from insert to dequeue, callbacks are spans on their thread
+			const bool async = entry.event == Event::Insert || entry.event == Event::Dequeue || entry.event == Event::Cancel;
+			const char *name = async ? "pending" : "callback";
+			const char *phase = "E";
+			switch (entry.event) {
+			case Event::Insert:
+				phase = "b";
+				break;
+			case Event::Dequeue:
+			case Event::Cancel:
+				phase = "e";
+				break;
+			case Event::CallbackStart:
+				phase = "B";
+				break;
+			case Event::CallbackEnd:
+				break;
+			}
+
+			out << (i ? ",\n" : "\n") << "{\"name\":\"" << name << "\",\"cat\":\"timer\",\"ph\":\"" << phase
+				<< "\",\"ts\":" << std::fixed << std::setprecision(3) << timestamp << ",\"pid\":1,\"tid\":" << entry.thread;
+			if (async) {
+				out << ",\"id\":\"" << entry.timer << "-" << entry.generation << "\"";
+			}
+			out << ",\"args\":{\"timer\":\"" << entry.timer << "\",\"generation\":" << entry.generation
+				<< (entry.event == Event::Cancel ? ",\"cancelled\":true" : "") << "}}";
+		}
+		out << "\n]}\n";
+	}
+
+private:
+	struct Entry {
+		std::chrono::steady_clock::time_point time;
+		const void *timer;
+		std::uint64_t generation;
+		std::uint32_t thread;
+		Event event;
+	};
+
+	// Small numbers read better than hashed thread ids in the viewer
+	static std::uint32_t threadIndex() {
+		static std::atomic<std::uint32_t> nextIndex{ 1 };
+		thread_local const std::uint32_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+		return index;
+	}
+
+	mutable std::mutex m_mtx;
+	std::vector<Entry> m_entries;
+	std::uint64_t m_recorded{ 0 };
+};
+
+// Logs inserts, cancels and fires of a manager to a binary file so the workload can be replayed
+// later with replayWorkload(). Timers are numbered in insertion order, a slot armed again gets a
+// new number.
+class WorkloadRecorder {
+public:
+	enum class Event : std::uint8_t {
+		Insert,
+		Cancel,
+		Fire
+	};
+
+	struct Record {
+		// Nanoseconds since the recorder was created
+		std::int64_t time;
+		std::uint32_t timer;
+		Event event;
+		std::uint8_t priority;
+		std::uint16_t reserved;
+		// Nanoseconds from the insert to the deadline, only for inserts
+		std::int64_t delay;
+	};
+
+	static_assert(sizeof(Record) == 24);
+
+	explicit WorkloadRecorder(const std::filesystem::path &path)
+		: m_file(path, std::ios::binary | std::ios::trunc) {
+		if (!m_file) {
+			throw std::runtime_error("cannot create workload file " + path.string());
+		}
+
+		const FileHeader header{ { 'T', 'M', 'W', 'L' }, Version };
+		m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	}
+
+	void record(Event event, const void *timer, std::chrono::steady_clock::duration delay = {}, std::uint8_t priority = 0) {
+		const std::int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+
+		std::lock_guard lock(m_mtx);
+
+		std::uint32_t number;
+		if (event == Event::Insert) {
+			number = m_nextTimer++;
+			m_timers[timer] = number;
+		}
+		else {
+			// Timers inserted before recording started are not known
+			const auto it = m_timers.find(timer);
+			if (it == m_timers.end()) {
+				return;
+			}
+			number = it->second;
+			m_timers.erase(it);
+		}
+
+		const Record record{ time, number, event, priority, 0, std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count() };
+		m_file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+	}
+
+	void flush() {
+		std::lock_guard lock(m_mtx);
+		m_file.flush();
+	}
+
+	static std::vector<Record> load(const std::filesystem::path &path) {
+		std::ifstream file(path, std::ios::binary);
+
+		FileHeader header{};
+		if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, "TMWL", 4) != 0 || header.version != Version) {
+			throw std::runtime_error("not a workload file " + path.string());
+		}
+
+		std::vector<Record> records;
+		Record record;
+		while (file.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+			records.push_back(record);
+		}
+
+		return records;
+	}
+
+private:
+	struct FileHeader {
+		char magic[4];
+		std::uint32_t version;
+	};
+
+	static constexpr std::uint32_t Version = 1;
+
+	const std::chrono::steady_clock::time_point m_start{ std::chrono::steady_clock::now() };
+	std::mutex m_mtx;
+	std::ofstream m_file;
+	std::unordered_map<const void *, std::uint32_t> m_timers;
+	std::uint32_t m_nextTimer{ 0 };
+};
+
+// Lets one thread sleep until a deadline while others wake it only if they need it earlier. The
+// deadline it sleeps until is published in an atomic word, so a waker that finds the thread awake
+// or sleeping long enough never enters the kernel. On Linux the thread sleeps on a futex.
+class DeadlineParker {
+public:
+	// Steady clock nanoseconds, like the heap deadlines
+	using Tick = std::int64_t;
+
+	static constexpr Tick Awake = std::numeric_limits<Tick>::min();
+	static constexpr Tick Forever = std::numeric_limits<Tick>::max();
+
+	// Called by the sleeping thread while the state the wakers change is still locked, so a change
+	// made after it sees the published deadline
+	std::uint32_t prepare(Tick deadline) {
+		const std::uint32_t ticket = m_sequence.load(std::memory_order_acquire);
+		m_parkedUntil.store(deadline, std::memory_order_seq_cst);
+		return ticket;
+	}
+
+	// Returns at the deadline, on a wake, or right away if woken since prepare()
+	void park(std::uint32_t ticket, Tick deadline) {
+#if defined(TIMERS_HAS_LINUX)
+		timespec until{};
+		if (deadline != Forever) {
+			until.tv_sec = static_cast<time_t>(deadline / 1'000'000'000);
+			until.tv_nsec = static_cast<long>(deadline % 1'000'000'000);
+		}
+
+		// Absolute CLOCK_MONOTONIC timeout, the clock behind std::chrono::steady_clock
+		::syscall(SYS_futex, futexWord(), FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, ticket, deadline == Forever ? nullptr : &until, nullptr, FUTEX_BITSET_MATCH_ANY);
+#else
+		std::unique_lock lock(m_mtx);
+		const auto woken = [&] { return m_sequence.load(std::memory_order_acquire) != ticket; };
+		if (deadline == Forever) {
+			m_cv.wait(lock, woken);
+		}
+		else {
+			m_cv.wait_until(lock, std::chrono::steady_clock::time_point{ std::chrono::nanoseconds{ deadline } }, woken);
+		}
+#endif
+		m_parkedUntil.store(Awake, std::memory_order_relaxed);
+	}
+
+	// True if the thread sleeps past the deadline and has to be woken for it
+	bool parkedPast(Tick deadline) const {
+		return deadline < m_parkedUntil.load(std::memory_order_seq_cst);
+	}
+
+	// Only the first waker of a sleep makes the system call
+	void wake() {
+		if (m_parkedUntil.exchange(Awake, std::memory_order_seq_cst) == Awake) {
+			return;
+		}
+
+		m_sequence.fetch_add(1, std::memory_order_release);
+#if defined(TIMERS_HAS_LINUX)
+		::syscall(SYS_futex, futexWord(), FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, nullptr, nullptr, 0);
+#else
+		{
+			std::lock_guard lock(m_mtx);
+		}
+		m_cv.notify_one();
+#endif
+	}
+
+private:
+#if defined(TIMERS_HAS_LINUX)
+	std::uint32_t *futexWord() {
+		static_assert(sizeof(m_sequence) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free);
+		return reinterpret_cast<std::uint32_t *>(&m_sequence);
+	}
+#else
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+#endif
+
+	std::atomic<Tick> m_parkedUntil{ Awake };
+	std::atomic<std::uint32_t> m_sequence{ 0 };
+};
+
+#if defined(TIMERS_HAS_LINUX)
+// Calls back from its own thread whenever the wall clock is set. A CLOCK_REALTIME timerfd armed
+// with TFD_TIMER_CANCEL_ON_SET fails the blocked read with ECANCELED on every step.
+class ClockStepWatcher {
+public:
+	explicit ClockStepWatcher(std::function<void()> onStep)
+		: m_onStep(std::move(onStep)) {
+		m_fd = ::timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+		if (m_fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "timerfd_create");
+		}
+
+		if (!arm(Never)) {
+			const int error = errno;
+			::close(m_fd);
+			throw std::system_error(error, std::generic_category(), "timerfd_settime");
+		}
+
+		m_thread = std::jthread([this](std::stop_token stopToken) {
+			watch(stopToken);
+		});
+	}
+
+	ClockStepWatcher(const ClockStepWatcher &) = delete;
+	ClockStepWatcher &operator=(const ClockStepWatcher &) = delete;
+
+	~ClockStepWatcher() {
+		m_thread.request_stop();
+		// An expiry in the past ends the read
+		arm(timespec{ 0, 1 });
+		m_thread.join();
+		::close(m_fd);
+	}
+
+private:
+	static constexpr timespec Never{ std::numeric_limits<time_t>::max(), 0 };
+
+	bool arm(timespec at) {
+		itimerspec spec{};
+		spec.it_value = at;
+		return ::timerfd_settime(m_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr) == 0;
+	}
+
+	void watch(std::stop_token stopToken) {
+		while (!stopToken.stop_requested()) {
+			std::uint64_t expirations = 0;
+			if (::read(m_fd, &expirations, sizeof(expirations)) < 0 && errno == ECANCELED) {
+				// Armed again first, a step during the callback is not lost
+				arm(Never);
+				m_onStep();
+			}
+		}
+	}
+
+	std::function<void()> m_onStep;
+	int m_fd{ -1 };
+	std::jthread m_thread;
+};
+#endif
+
+class TimersManager {
+public:
+	using TimerCallback = std::function<void()>;
+
+	// Timers inserted with the same group can be cancelled together
+	using GroupId = std::uint32_t;
+	static constexpr GroupId NoGroup = 0;
+
+	// Among the timers due when the worker wakes up, higher priority lanes are dispatched first. A
+	// backlog larger than one batch is taken in full before the lower lanes run.
+	enum class Priority : std::uint8_t {
+		High,
+		Normal,
+		Low
+	};
+
+	// What happens to the pending timers when the manager is destroyed
+	enum class ShutdownPolicy {
+		// Dropped without running
+		Discard,
+		// The ones already due run, the rest are dropped
+		RunDue,
+		// All of them run right away, regardless of their timeout
+		RunAll
+	};
+
+	// What an insert does when Options::maxTimers timers are already pending
+	enum class AdmissionPolicy {
+		// Fails right away
+		Reject,
+		// Waits up to Options::admissionTimeout for a timer to fire or be cancelled. Called from a
+		// callback on the worker or the backup dispatcher it rejects instead, that thread would be
+		// waiting for itself.
+		Block,
+		// Drops the pending timers with the farthest deadlines, a 64th of the limit at a time so the
+		// search through the heap is paid once per batch. When the new timer would be among them it
+		// is rejected and nothing is dropped. The future of a dropped scheduleAfter() fails with
+		// std::future_errc::broken_promise.
+		DropFarthest
+	};
+
+	// Outcome of an insert, see TimerId::admission()
+	enum class Admission : std::uint8_t {
+		Admitted,
+		// Admitted after dropping the pending timers with the farthest deadlines
+		AdmittedByDropping,
+		Rejected,
+		// Blocked for Options::admissionTimeout without room opening up
+		TimedOut
+	};
+
+	// Timers inserted with insertPersistentTimer() are rebuilt from a registered factory on restore
+	using CallbackTypeId = std::uint32_t;
+	using CallbackFactory = std::function<TimerCallback(std::string_view payload)>;
+	static constexpr CallbackTypeId NoCallbackType = 0;
+
+	// Scheduling class of the worker threads, the real-time ones usually need CAP_SYS_NICE
+	enum class SchedulingPolicy {
+		Default,
+		Fifo,
+		RoundRobin
+	};
+
+	// Managers sharing one steal each other's due callbacks during bursts, see StealGroup below
+	class StealGroup;
+
+	// What the watchdog knows about a callback that overran its budget
+	struct SlowCallbackReport {
+		// Type of the callable, or "coroutine" for a resumed awaiter
+		std::string callbackType;
+		std::chrono::steady_clock::duration running{};
+		std::chrono::steady_clock::time_point deadline{};
+		Priority priority{ Priority::Normal };
+		GroupId group{ NoGroup };
+	};
+
+	// Snapshot returned by statistics(), counters are totals since construction
+	struct Statistics {
+		std::size_t pending{ 0 };
+		std::uint64_t inserted{ 0 };
+		std::uint64_t fired{ 0 };
+		std::uint64_t cancelled{ 0 };
+		// Inserts turned away by admission control, timed out ones included, and timers it dropped
+		std::uint64_t rejected{ 0 };
+		std::uint64_t dropped{ 0 };
+		std::size_t maxHeapSize{ 0 };
+		// Times the worker woke up, and how many of those found nothing to run
+		std::uint64_t wakeups{ 0 };
+		std::uint64_t spuriousWakeups{ 0 };
+		// Time spent waiting for the timers lock when it was contended
+		std::chrono::nanoseconds lockWaitTime{ 0 };
+		std::chrono::nanoseconds callbackTime{ 0 };
+		// Empty when nothing is pending
+		std::optional<std::chrono::steady_clock::time_point> nextDeadline;
+	};
+
+	struct Options {
+		ShutdownPolicy shutdownPolicy{ ShutdownPolicy::Discard };
+		// Drained callbacks not started by then are dropped
+		std::chrono::milliseconds drainDeadline{ 1000 };
+		// Threads running the drained callbacks, 0 means one per hardware thread
+		unsigned drainThreads{ 0 };
+
+		// Callbacks running longer than this are reported, zero disables the watchdog
+		std::chrono::milliseconds callbackBudget{ 0 };
+		// While a callback overruns its budget a backup thread fires the rest of the worker's batch
+		// and the other due timers
+		bool failoverOnSlowCallback{ false };
+		// Prints to std::cerr when empty, runs on the watchdog thread
+		std::function<void(const SlowCallbackReport &)> onSlowCallback{};
+
+		// Events kept by the in-memory tracer, zero disables it
+		std::size_t traceCapacity{ 0 };
+
+		// Receives every insert, cancel and fire when set
+		std::shared_ptr<WorkloadRecorder> recorder{};
+
+		// Applied by the worker threads when they start, only on Linux. A setting that fails is
+		// reported on std::cerr and the thread goes on without it.
+		std::vector<unsigned> workerCpus{};
+		SchedulingPolicy workerScheduling{ SchedulingPolicy::Default };
+		// sched_priority for the real-time policies, 1 to 99
+		int workerPriority{ 1 };
+		// At most 15 characters are kept
+		std::string workerName{};
+		// Locks the stack in memory so a callback never waits for it to be paged in
+		bool lockWorkerStack{ false };
+
+		// Idle workers of the group help with large batches of due timers
+		std::shared_ptr<StealGroup> stealGroup{};
+
+		// Deadline granularity when built with TIMERS_COMPACT_DEADLINES. Timers fire up to this much
+		// late, in exchange deadlines take 4 bytes and up to 3/4 of 2^32 ticks ahead stay compact.
+		std::chrono::nanoseconds tickResolution{ 100us };
+
+		// Pending timers allowed at once, zero means no limit. Only inserts of a callback are held to
+		// it, awaited sleeps and armed slots always get in but count towards it.
+		std::size_t maxTimers{ 0 };
+		AdmissionPolicy admissionPolicy{ AdmissionPolicy::Reject };
+		// How long AdmissionPolicy::Block waits for room
+		std::chrono::milliseconds admissionTimeout{ 100 };
+	};
+
+private:
+	using TimeoutType = std::chrono::steady_clock::time_point;
+
+	template <typename TimeoutType>
+	static constexpr bool IsTimeoutDuration = std::is_same_v<TimeoutType, std::chrono::duration<typename TimeoutType::rep, typename TimeoutType::period>>;
+
+	struct TimerNode;
+
+	// Built with TIMERS_COMPACT_DEADLINES the heap keeps 32-bit deadlines of Options::tickResolution
+#if defined(TIMERS_COMPACT_DEADLINES)
+	using DeadlineHeap = CompactTimerHeap<TimerNode *>;
+#else
+	using DeadlineHeap = TimerHeap<TimerNode *>;
+#endif
+
+	// Heap entry, either owned by the manager's pool or embedded in an awaiter
+	struct TimerNode {
+		// Allocated only for persistent, durable and wall clock timers, the rest stay small
+		struct Metadata {
+			// Only set for persistent timers
+			CallbackTypeId typeId{ NoCallbackType };
+			std::string payload;
+
+			// Id in the durable log, 0 when not logged
+			std::uint64_t durableId{ 0 };
+
+			// system_clock nanoseconds for wall clock timers, 0 for steady ones. The heap still holds
+			// the steady deadline, it is recomputed from this one when the wall clock jumps.
+			std::int64_t wallDeadline{ 0 };
+		};
+
+		TimerCallback callback{};
+		std::coroutine_handle<> continuation{};
+		std::size_t heapIndex{ DeadlineHeap::npos };
+		std::uint64_t generation{ 0 };
+		bool pooled{ false };
+		Priority priority{ Priority::Normal };
+
+		// Intrusive list of the pending members of a group
+		GroupId group{ NoGroup };
+		TimerNode *groupPrev{ nullptr };
+		TimerNode *groupNext{ nullptr };
+
+		std::unique_ptr<Metadata> metadata;
+
+		bool pending() const {
+			return heapIndex != DeadlineHeap::npos;
+		}
+
+		CallbackTypeId typeId() const {
+			return metadata ? metadata->typeId : NoCallbackType;
+		}
+
+		std::uint64_t durableId() const {
+			return metadata ? metadata->durableId : 0;
+		}
+
+		std::int64_t wallDeadline() const {
+			return metadata ? metadata->wallDeadline : 0;
+		}
+
+		Metadata &ensureMetadata() {
+			if (!metadata) {
+				metadata = std::make_unique<Metadata>();
+			}
+			return *metadata;
+		}
+	};
+
+	using Tick = DeadlineHeap::Tick;
+
+	static constexpr Tick NoDeadline = std::numeric_limits<Tick>::max();
+
+	// Written with relaxed stores, the heap related ones only with the timers lock held
+	struct StatCounters {
+		std::atomic<std::size_t> pending{ 0 };
+		std::atomic<std::uint64_t> inserted{ 0 };
+		std::atomic<std::uint64_t> fired{ 0 };
+		std::atomic<std::uint64_t> cancelled{ 0 };
+		std::atomic<std::uint64_t> rejected{ 0 };
+		std::atomic<std::uint64_t> dropped{ 0 };
+		std::atomic<std::size_t> maxHeapSize{ 0 };
+		std::atomic<std::uint64_t> wakeups{ 0 };
+		std::atomic<std::uint64_t> spuriousWakeups{ 0 };
+		std::atomic<std::int64_t> lockWaitNanoseconds{ 0 };
+		std::atomic<std::int64_t> callbackNanoseconds{ 0 };
+		std::atomic<Tick> nextDeadline{ NoDeadline };
+	};
+
+	static constexpr std::size_t PriorityLanes = 3;
+
+	// Upper bound of timers taken per lock acquisition, keeps the lock hold time short during bursts
+	static constexpr std::size_t MaxBatchSize = 256;
+
+	// Batches with more due timers than this are offered to the other workers of the steal group
+	static constexpr std::size_t StealThreshold = 32;
+
+	// With AdmissionPolicy::DropFarthest this fraction of Options::maxTimers is dropped at once
+	static constexpr std::size_t DropBatchDivisor = 64;
+
+	// Callbacks handed to a drain thread at once on shutdown
+	static constexpr std::size_t DrainBatchSize = 64;
+
+	// With wall clock timers pending and no ClockStepWatcher the worker looks at the clocks at least
+	// this often, and a change of their offset above the threshold counts as a jump
+	static constexpr auto WallClockCheckInterval = 1s;
+	static constexpr auto ClockJumpThreshold = 50ms;
+
+	static TimeoutType timeNow() {
+		return std::chrono::steady_clock::now();
+	}
+
+	static Tick toTick(TimeoutType timeout) {
+		return timeout.time_since_epoch().count();
+	}
+
+	static TimeoutType fromTick(Tick tick) {
+		return TimeoutType{ TimeoutType::duration{ tick } };
+	}
+
+	template <typename R>
+	struct FutureState {
+		using Value = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+		virtual ~FutureState() = default;
+
+		void retain() {
+			refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void release() {
+			if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				delete this;
+			}
+		}
+
+		std::atomic<std::uint32_t> refs{ 1 };
+		std::atomic<bool> ready{ false };
+		std::optional<Value> value;
+		std::exception_ptr exception;
+	};
+
+	// Shared state and the scheduled function in a single allocation
+	template <typename R, typename F>
+	struct ScheduledTask final : FutureState<R> {
+		explicit ScheduledTask(F &&fn)
+			: function(std::forward<F>(fn)) {
+
+		}
+
+		void run() {
+			try {
+				if constexpr (std::is_void_v<R>) {
+					std::invoke(function);
+					this->value.emplace();
+				}
+				else {
+					this->value.emplace(std::invoke(function));
+				}
+			}
+			catch (...) {
+				this->exception = std::current_exception();
+			}
+
+			complete();
+		}
+
+		// The last copy of the callback went away without running, like a std::promise destroyed unset
+		void abandon() {
+			this->exception = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+			complete();
+		}
+
+		void complete() {
+			this->ready.store(true, std::memory_order_release);
+			this->ready.notify_all();
+		}
+
+		std::decay_t<F> function;
+		// Live ScheduledCall copies
+		std::atomic<std::uint32_t> calls{ 1 };
+	};
+
+	// What is stored in the TimerCallback, holds one reference to the task
+	template <typename R, typename F>
+	struct ScheduledCall {
+		explicit ScheduledCall(ScheduledTask<R, F> *task)
+			: task(task) {
+
+		}
+
+		ScheduledCall(const ScheduledCall &other)
+			: task(other.task) {
+			task->retain();
+			task->calls.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		ScheduledCall(ScheduledCall &&other) noexcept
+			: task(std::exchange(other.task, nullptr)) {
+
+		}
+
+		ScheduledCall &operator=(const ScheduledCall &) = delete;
+		ScheduledCall &operator=(ScheduledCall &&) = delete;
+
+		// Destroyed unrun on a discarding shutdown, a failed insert or an admission drop, the waiting
+		// future gets broken_promise instead of hanging
+		~ScheduledCall() {
+			if (task) {
+				if (task->calls.fetch_sub(1, std::memory_order_acq_rel) == 1 && !task->ready.load(std::memory_order_acquire)) {
+					task->abandon();
+				}
+				task->release();
+			}
+		}
+
+		void operator()() {
+			task->run();
+		}
+
+		ScheduledTask<R, F> *task;
+	};
+
+public:
+	// Identifies a timer returned by insertTimer(), stays safe to use after the timer fired
+	class TimerId {
+	public:
+		TimerId() = default;
+
+		// False when admission control turned the timer away
+		bool valid() const {
+			return m_node != nullptr;
+		}
+
+		Admission admission() const {
+			return m_admission;
+		}
+
+	private:
+		friend class TimersManager;
+
+		TimerId(TimerNode *node, std::uint64_t generation, Admission admission = Admission::Admitted)
+			: m_node(node)
+			, m_generation(generation)
+			, m_admission(admission) {
+
+		}
+
+		explicit TimerId(Admission admission)
+			: m_admission(admission) {
+
+		}
+
+		TimerNode *m_node{ nullptr };
+		std::uint64_t m_generation{ 0 };
+		Admission m_admission{ Admission::Admitted };
+	};
+
+	// Result of scheduleAfter(). Dropping it before the result is ready cancels the timer.
+	template <typename R>
+	class Future {
+	public:
+		Future() = default;
+
+		Future(const Future &) = delete;
+		Future &operator=(const Future &) = delete;
+
+		Future(Future &&other) noexcept
+			: m_manager(std::exchange(other.m_manager, nullptr))
+			, m_timer(other.m_timer)
+			, m_state(std::exchange(other.m_state, nullptr)) {
+
+		}
+
+		Future &operator=(Future &&other) noexcept {
+			if (this != &other) {
+				reset();
+				m_manager = std::exchange(other.m_manager, nullptr);
+				m_timer = other.m_timer;
+				m_state = std::exchange(other.m_state, nullptr);
+			}
+			return *this;
+		}
+
+		~Future() {
+			reset();
+		}
+
+		bool valid() const {
+			return m_state != nullptr;
+		}
+
+		bool ready() const {
+			return m_state->ready.load(std::memory_order_acquire);
+		}
+
+		void wait() const {
+			m_state->ready.wait(false, std::memory_order_acquire);
+		}
+
+		R get() {
+			wait();
+
+			if (m_state->exception) {
+				std::rethrow_exception(m_state->exception);
+			}
+
+			if constexpr (!std::is_void_v<R>) {
+				return std::move(*m_state->value);
+			}
+		}
+
+	private:
+		friend class TimersManager;
+
+		Future(TimersManager &manager, TimerId timer, FutureState<R> *state)
+			: m_manager(&manager)
+			, m_timer(timer)
+			, m_state(state) {
+
+		}
+
+		void reset() {
+			if (!m_state) {
+				return;
+			}
+
+			if (!ready()) {
+				m_manager->cancelTimer(m_timer);
+			}
+
+			std::exchange(m_state, nullptr)->release();
+		}
+
+		TimersManager *m_manager{ nullptr };
+		TimerId m_timer;
+		FutureState<R> *m_state{ nullptr };
+	};
+
+	// Handed to the operation started by withTimeout(). The race with the timeout is settled under
+	// the manager's lock by cancelling the timer, so it needs no state of its own.
+	class TimeoutCompletion {
+	public:
+		// Returns true if the operation won, false if the timeout already fired (or is firing)
+		bool complete() {
+			return m_manager->cancelTimer(std::exchange(m_timer, TimerId{}));
+		}
+
+	private:
+		friend class TimersManager;
+
+		TimeoutCompletion(TimersManager &manager, TimerId timer)
+			: m_manager(&manager)
+			, m_timer(timer) {
+
+		}
+
+		TimersManager *m_manager;
+		TimerId m_timer;
+	};
+
+	TimersManager()
+		: TimersManager(Options{}) {
+
+	}
+
+	explicit TimersManager(Options options)
+		: m_options(std::move(options))
+#if defined(TIMERS_COMPACT_DEADLINES)
+		, m_timers(std::chrono::duration_cast<TimeoutType::duration>(m_options.tickResolution).count(), toTick(timeNow()))
+#endif
+	{
+		if (m_options.traceCapacity > 0) {
+			m_tracer = std::make_unique<TimerTracer>(m_options.traceCapacity);
+		}
+
+		if (m_options.stealGroup) {
+			std::lock_guard lock(m_options.stealGroup->m_mtx);
+			m_options.stealGroup->m_members.push_back(this);
+		}
+
+		m_worker = std::jthread([this](std::stop_token stopToken) {
+			workerLoop(stopToken);
+		});
+
+		if (m_options.callbackBudget.count() > 0) {
+			m_watchdog = std::jthread([this](std::stop_token stopToken) {
+				watchdogLoop(stopToken);
+			});
+
+			if (m_options.failoverOnSlowCallback) {
+				m_backupWorker = std::jthread([this](std::stop_token stopToken) {
+					backupLoop(stopToken);
+				});
+			}
+		}
+	}
+
+	TimersManager(const TimersManager &) = delete;
+	TimersManager &operator = (const TimersManager &) = delete;
+	TimersManager(TimersManager &&) = delete;
+	TimersManager &operator=(TimersManager &&) = delete;
+
+	~TimersManager() {
+		// Make sure the worker is stopped before clearing any memory
+		if (m_worker.joinable()) {
+			{
+				// Seen by the worker before it parks again
+				const auto lock = lockTimers();
+				m_worker.request_stop();
+			}
+			notifyWorker();
+			m_worker.join();
+		}
+
+		if (m_watchdog.joinable()) {
+			m_watchdog.request_stop();
+			m_watchdogCv.notify_all();
+			m_watchdog.join();
+		}
+
+		if (m_backupWorker.joinable()) {
+			{
+				const auto lock = lockTimers();
+				m_backupWorker.request_stop();
+			}
+			m_cv.notify_all();
+			m_backupCv.notify_all();
+			m_backupWorker.join();
+		}
+
+		// Waits for the other members to stop stealing from this one
+		if (m_options.stealGroup) {
+			std::lock_guard lock(m_options.stealGroup->m_mtx);
+			std::erase(m_options.stealGroup->m_members, this);
+		}
+
+		drainPendingTimers();
+	}
+
+	template <typename Timeout>
+	requires IsTimeoutDuration<Timeout>
+	TimerId insertTimer(TimerCallback cb, Timeout timeout, GroupId group = NoGroup, Priority priority = Priority::Normal) {
+		const TimeoutType internalTimeout = timeNow() + std::chrono::duration_cast<typename TimeoutType::duration>(timeout);
+		return insertPooledTimer(std::move(cb), internalTimeout, group, priority, NoCallbackType, {}, 0);
+	}
+
+	// Fires at a wall clock time, even if the system clock is stepped in the meantime
+	TimerId insertTimerAt(TimerCallback cb, std::chrono::system_clock::time_point deadline, GroupId group = NoGroup, Priority priority = Priority::Normal) {
+		const std::int64_t wallDeadline = toWallNanoseconds(deadline);
+		return insertPooledTimer(std::move(cb), fromWallClock(wallDeadline), group, priority, NoCallbackType, {}, 0, wallDeadline);
+	}
+
+	// Factories have to be registered before timers of their type are inserted or restored
+	void registerCallbackType(CallbackTypeId typeId, CallbackFactory factory) {
+		const auto lock = lockTimers();
+
+		if (typeId == NoCallbackType || !m_callbackTypes.try_emplace(typeId, std::move(factory)).second) {
+			throw std::invalid_argument("callback type id is reserved or already registered");
+		}
+	}
+
+	// Timer that is described by a registered type and its payload, so it can be saved in a snapshot
+	template <typename Timeout>
+	requires IsTimeoutDuration<Timeout>
+	TimerId insertPersistentTimer(CallbackTypeId typeId, std::string payload, Timeout timeout, GroupId group = NoGroup, Priority priority = Priority::Normal) {
+		const TimeoutType internalTimeout = timeNow() + std::chrono::duration_cast<typename TimeoutType::duration>(timeout);
+		TimerCallback cb = callbackFactory(typeId)(payload);
+
+		std::uint64_t durableId = 0;
+#if defined(TIMERS_HAS_POSIX)
+		// With a durable log the timer is on disk before it can fire
+		if (m_durableLog) {
+			durableId = m_durableLog->allocateId();
+			const std::uint64_t sequence = m_durableLog->appendInsert(DurableTimerLog::Record{ durableId, toWallClock(internalTimeout), typeId, static_cast<std::uint8_t>(priority), payload });
+			m_durableLog->waitDurable(sequence);
+		}
+#endif
+
+		return insertPooledTimer(std::move(cb), internalTimeout, group, priority, typeId, std::move(payload), durableId);
+	}
+
+#if defined(TIMERS_HAS_POSIX)
+	// Writes the pending persistent timers to `path`, returns how many were saved
+	std::size_t saveSnapshot(const std::filesystem::path &path) const {
+		struct Entry {
+			Tick deadline;
+			CallbackTypeId typeId;
+			Priority priority;
+			std::string payload;
+		};
+
+		std::vector<Entry> entries;
+
+		{
+			const auto lock = lockTimers();
+
+			entries.reserve(m_timers.size());
+			m_timers.forEach([&](Tick deadline, const TimerNode *node) {
+				if (node->typeId() != NoCallbackType) {
+					entries.push_back(Entry{ deadline, node->typeId(), node->priority, node->metadata->payload });
+				}
+			});
+		}
+
+		// Deadlines are stored relative to the wall clock, steady_clock doesn't survive a reboot
+		const Tick steadyNow = toTick(timeNow());
+		const std::int64_t savedAt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+		std::size_t size = sizeof(SnapshotHeader);
+		for (const Entry &entry : entries) {
+			size += snapshotRecordSize(entry.payload.size());
+		}
+
+		// Written aside and renamed over, a crash never leaves a half written snapshot behind
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp";
+
+		{
+			MappedFile file = MappedFile::create(tempPath, size);
+			std::byte *out = file.data();
+
+			const SnapshotHeader header{ SnapshotMagic, SnapshotVersion, entries.size(), savedAt };
+			std::memcpy(out, &header, sizeof(header));
+			out += sizeof(header);
+
+			for (const Entry &entry : entries) {
+				const auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(fromTick(entry.deadline) - fromTick(steadyNow)).count();
+				const SnapshotRecord record{ offset, entry.typeId, static_cast<std::uint32_t>(entry.payload.size()), static_cast<std::uint8_t>(entry.priority), {} };
+				std::memcpy(out, &record, sizeof(record));
+				std::memcpy(out + sizeof(record), entry.payload.data(), entry.payload.size());
+				out += snapshotRecordSize(entry.payload.size());
+			}
+
+			file.sync();
+		}
+
+		std::filesystem::rename(tempPath, path);
+		return entries.size();
+	}
+
+	// Loads the timers of a snapshot and heapifies once, returns how many were restored
+	std::size_t restoreSnapshot(const std::filesystem::path &path) {
+		std::vector<Restored> restored;
+
+		{
+			const MappedFile file = MappedFile::openReadOnly(path);
+			const std::byte *in = file.data();
+			const std::byte *end = in + file.size();
+
+			SnapshotHeader header{};
+			if (file.size() < sizeof(header)) {
+				throw std::runtime_error("truncated timers snapshot");
+			}
+			std::memcpy(&header, in, sizeof(header));
+			in += sizeof(header);
+
+			if (header.magic != SnapshotMagic || header.version != SnapshotVersion) {
+				throw std::runtime_error("not a timers snapshot");
+			}
+
+			// Time that passed in wall clock terms since the snapshot was taken
+			const std::chrono::nanoseconds sinceSave{ std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - header.savedAt };
+			const TimeoutType steadyNow = timeNow();
+
+			restored.reserve(header.count);
+			for (std::uint64_t i = 0; i < header.count; ++i) {
+				SnapshotRecord record{};
+				if (end - in < static_cast<std::ptrdiff_t>(sizeof(record))) {
+					throw std::runtime_error("truncated timers snapshot");
+				}
+				std::memcpy(&record, in, sizeof(record));
+
+				if (static_cast<std::size_t>(end - in) < snapshotRecordSize(record.payloadSize)) {
+					throw std::runtime_error("truncated timers snapshot");
+				}
+
+				std::string payload(reinterpret_cast<const char *>(in + sizeof(record)), record.payloadSize);
+				in += snapshotRecordSize(record.payloadSize);
+
+				const TimeoutType deadline = steadyNow + std::chrono::duration_cast<TimeoutType::duration>(std::chrono::nanoseconds{ record.deadlineOffset } - sinceSave);
+				TimerCallback callback = callbackFactory(record.typeId)(payload);
+				restored.push_back(Restored{ deadline, std::move(callback), record.typeId, static_cast<Priority>(record.priority), std::move(payload), 0 });
+			}
+		}
+
+		bulkInsert(restored);
+		return restored.size();
+	}
+
+	// Makes persistent timers durable: they are logged before they are inserted and until they fire
+	// or get cancelled. The timers left in the log by the previous run are inserted again, so the
+	// callback types have to be registered before. Returns how many were recovered.
+	std::size_t openDurableLog(const std::filesystem::path &path, DurableTimerLog::Options options = {}) {
+		auto log = std::make_unique<DurableTimerLog>(path, options);
+
+		std::vector<Restored> recovered;
+		for (DurableTimerLog::Record &record : log->liveTimers()) {
+			TimerCallback callback = callbackFactory(record.typeId)(record.payload);
+			recovered.push_back(Restored{ fromWallClock(record.wallDeadline), std::move(callback), record.typeId, static_cast<Priority>(record.priority), std::move(record.payload), record.id });
+		}
+
+		m_durableLog = std::move(log);
+		bulkInsert(recovered);
+		return recovered.size();
+	}
+
+	// fsyncs issued by the durable log so far
+	std::uint64_t durableLogSyncs() const {
+		return m_durableLog ? m_durableLog->syncCount() : 0;
+	}
+#endif
+
+	// Returns false if the timer already fired or was cancelled
+	bool cancelTimer(TimerId id) {
+		if (!id.valid()) {
+			return false;
+		}
+
+		TimerCallback cb;
+		std::uint64_t durableId = 0;
+
+		{
+			const auto lock = lockTimers();
+
+			TimerNode &node = *id.m_node;
+			if (node.generation != id.m_generation || !node.pending()) {
+				return false;
+			}
+
+			removeNode(node);
+			cb = std::move(node.callback);
+			durableId = node.durableId();
+			releaseNode(node);
+		}
+
+		forgetDurable(durableId);
+
+		// The callback is destroyed outside the lock, its destructor may use the manager
+		return true;
+	}
+
+	// Returns false when the manager was created without a trace capacity
+	bool writeChromeTrace(std::ostream &out) const {
+		if (!m_tracer) {
+			return false;
+		}
+
+		m_tracer->writeChromeTrace(out);
+		return true;
+	}
+
+	// Doesn't take the timers lock, the fields are read one by one and may be from slightly different moments
+	Statistics statistics() const {
+		Statistics stats;
+		stats.pending = m_stats.pending.load(std::memory_order_relaxed);
+		stats.inserted = m_stats.inserted.load(std::memory_order_relaxed);
+		stats.fired = m_stats.fired.load(std::memory_order_relaxed);
+		stats.cancelled = m_stats.cancelled.load(std::memory_order_relaxed);
+		stats.rejected = m_stats.rejected.load(std::memory_order_relaxed);
+		stats.dropped = m_stats.dropped.load(std::memory_order_relaxed);
+		stats.maxHeapSize = m_stats.maxHeapSize.load(std::memory_order_relaxed);
+		stats.wakeups = m_stats.wakeups.load(std::memory_order_relaxed);
+		stats.spuriousWakeups = m_stats.spuriousWakeups.load(std::memory_order_relaxed);
+		stats.lockWaitTime = std::chrono::nanoseconds{ m_stats.lockWaitNanoseconds.load(std::memory_order_relaxed) };
+		stats.callbackTime = std::chrono::nanoseconds{ m_stats.callbackNanoseconds.load(std::memory_order_relaxed) };
+
+		const Tick nextDeadline = m_stats.nextDeadline.load(std::memory_order_relaxed);
+		if (nextDeadline != NoDeadline) {
+			stats.nextDeadline = fromTick(nextDeadline);
+		}
+
+		return stats;
+	}
+
+	GroupId createGroup() {
+		return m_nextGroup.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Cancels every pending timer of the group under a single lock, returns how many there were
+	std::size_t cancelGroup(GroupId group) {
+		std::vector<TimerCallback> callbacks;
+		std::vector<std::uint64_t> durableIds;
+
+		{
+			const auto lock = lockTimers();
+
+			const auto it = m_groupHeads.find(group);
+			if (it == m_groupHeads.end()) {
+				return 0;
+			}
+
+			TimerNode *node = it->second;
+			m_groupHeads.erase(it);
+
+			while (node) {
+				TimerNode *next = node->groupNext;
+
+				// Already unlinked as a whole, skip the per-node unlinking in releaseNode()
+				node->group = NoGroup;
+				node->groupPrev = node->groupNext = nullptr;
+
+				removeNode(*node);
+				callbacks.push_back(std::move(node->callback));
+				if (node->durableId()) {
+					durableIds.push_back(node->durableId());
+				}
+				releaseNode(*node);
+
+				node = next;
+			}
+		}
+
+		for (const std::uint64_t durableId : durableIds) {
+			forgetDurable(durableId);
+		}
+
+		return callbacks.size();
+	}
+
+	// Starts `operation(TimeoutCompletion)` racing against `onTimeout`. Whichever comes first wins,
+	// completing in time removes the timer from the heap right away. Throws without starting the
+	// operation when admission control rejects the timer, nothing could win the race then.
+	template <typename Operation, typename Timeout, typename OnTimeout>
+	requires IsTimeoutDuration<Timeout> && std::is_invocable_v<Operation, TimeoutCompletion>
+	decltype(auto) withTimeout(Operation &&operation, Timeout timeout, OnTimeout &&onTimeout) {
+		const TimerId id = insertTimer(std::forward<OnTimeout>(onTimeout), timeout);
+		if (!id.valid()) {
+			throw std::runtime_error("timeout rejected by admission control");
+		}
+		return std::invoke(std::forward<Operation>(operation), TimeoutCompletion{ *this, id });
+	}
+
+	// Runs `fn` on the worker after `timeout` and hands its result through the returned future
+	template <typename F, typename Timeout>
+	requires IsTimeoutDuration<Timeout> && std::is_invocable_v<std::decay_t<F> &>
+	auto scheduleAfter(F &&fn, Timeout timeout) -> Future<std::invoke_result_t<std::decay_t<F> &>> {
+		using R = std::invoke_result_t<std::decay_t<F> &>;
+
+		auto *task = new ScheduledTask<R, F>(std::forward<F>(fn));
+
+		// One reference for the future, one for the timer
+		task->retain();
+		const TimerId id = insertTimer(ScheduledCall<R, F>{ task }, timeout);
+
+		// The rejected callback already failed the task with broken_promise, this says why
+		if (!id.valid()) {
+			task->exception = std::make_exception_ptr(std::runtime_error("timer rejected by admission control"));
+			task->ready.store(true, std::memory_order_release);
+		}
+
+		return Future<R>{ *this, id, task };
+	}
+
+	// Awaitable returned by sleepFor()/sleepUntil(). The timer node lives inside the awaiter, hence
+	// in the coroutine frame, so suspending doesn't allocate. Destroying a suspended coroutine
+	// removes its pending timer, or stops the resume if the worker already took it.
+	class SleepAwaiter {
+	public:
+		SleepAwaiter(TimersManager &manager, TimeoutType deadline)
+			: m_manager(manager)
+			, m_deadline(deadline) {
+
+		}
+
+		SleepAwaiter(const SleepAwaiter &) = delete;
+		SleepAwaiter &operator=(const SleepAwaiter &) = delete;
+		SleepAwaiter(SleepAwaiter &&) = delete;
+		SleepAwaiter &operator=(SleepAwaiter &&) = delete;
+
+		~SleepAwaiter() {
+			if (m_suspended && !m_resumed) {
+				m_manager.cancelNode(m_node);
+			}
+		}
+
+		bool await_ready() const {
+			return m_deadline <= timeNow();
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			m_node.continuation = handle;
+			m_suspended = true;
+			m_manager.insertNode(m_node, m_deadline);
+		}
+
+		void await_resume() {
+			m_resumed = true;
+		}
+
+	private:
+		TimersManager &m_manager;
+		TimeoutType m_deadline;
+		TimerNode m_node;
+		bool m_suspended{ false };
+		bool m_resumed{ false };
+	};
+
+	template <typename Timeout>
+	requires IsTimeoutDuration<Timeout>
+	SleepAwaiter sleepFor(Timeout timeout) {
+		return SleepAwaiter{ *this, timeNow() + std::chrono::duration_cast<typename TimeoutType::duration>(timeout) };
+	}
+
+	SleepAwaiter sleepUntil(TimeoutType deadline) {
+		return SleepAwaiter{ *this, deadline };
+	}
+
+	// Timer with a fixed callback that can be armed again and again without touching the node pool.
+	// Re-arming a pending slot just moves it in the heap. The destructor waits for a running callback.
+	class TimerSlot {
+	public:
+		TimerSlot(TimersManager &manager, TimerCallback callback)
+			: m_manager(manager) {
+			m_node.callback = std::move(callback);
+		}
+
+		TimerSlot(const TimerSlot &) = delete;
+		TimerSlot &operator=(const TimerSlot &) = delete;
+		TimerSlot(TimerSlot &&) = delete;
+		TimerSlot &operator=(TimerSlot &&) = delete;
+
+		~TimerSlot() {
+			m_manager.detachSlot(m_node);
+		}
+
+		template <typename Timeout>
+		requires IsTimeoutDuration<Timeout>
+		void arm(Timeout timeout) {
+			armAt(timeNow() + std::chrono::duration_cast<typename TimeoutType::duration>(timeout));
+		}
+
+		void armAt(TimeoutType deadline) {
+			m_manager.armSlot(m_node, deadline, 0);
+		}
+
+		void armAtWallClock(std::chrono::system_clock::time_point deadline) {
+			const std::int64_t wallDeadline = toWallNanoseconds(deadline);
+			m_manager.armSlot(m_node, fromWallClock(wallDeadline), wallDeadline);
+		}
+
+		// Returns false if the slot wasn't armed
+		bool disarm() {
+			return m_manager.disarmSlot(m_node);
+		}
+
+		bool armed() const {
+			std::lock_guard lock(m_manager.m_mtx);
+			return m_node.pending();
+		}
+
+	private:
+		TimersManager &m_manager;
+		TimerNode m_node;
+	};
+
+private:
+	struct DueTimer {
+		TimerCallback callback;
+		Tick deadline;
+		GroupId group;
+		std::uint64_t durableId;
+		// Identify the timer in traces, the node itself is already back in the pool
+		const TimerNode *node;
+		std::uint64_t generation;
+		Priority priority;
+	};
+
+	struct RunningCallback {
+		TimeoutType start;
+		std::uint64_t serial;
+		const char *callbackType;
+		Tick deadline;
+		Priority priority;
+		GroupId group;
+	};
+
+	// Persistent timer read back from a snapshot or the durable log
+	struct Restored {
+		TimeoutType deadline;
+		TimerCallback callback;
+		CallbackTypeId typeId;
+		Priority priority;
+		std::string payload;
+		std::uint64_t durableId;
+	};
+
+	// Appends everything and heapifies once
+	void bulkInsert(std::vector<Restored> &timers) {
+		{
+			const auto lock = lockTimers();
+
+			for (Restored &timer : timers) {
+				TimerNode &node = acquireNode();
+				node.callback = std::move(timer.callback);
+				node.priority = timer.priority;
+				TimerNode::Metadata &metadata = node.ensureMetadata();
+				metadata.typeId = timer.typeId;
+				metadata.payload = std::move(timer.payload);
+				metadata.durableId = timer.durableId;
+				m_timers.append(toTick(timer.deadline), &node);
+				TIMERS_PROBE(insert, &node, node.generation);
+				trace(TimerTracer::Event::Insert, &node, node.generation);
+			}
+
+			m_timers.heapify();
+			m_stats.inserted.fetch_add(timers.size(), std::memory_order_relaxed);
+			publishHeapState();
+		}
+
+		notifyWorker();
+	}
+
+	static std::int64_t toWallNanoseconds(std::chrono::system_clock::time_point timePoint) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count();
+	}
+
+	static std::int64_t toWallClock(TimeoutType timeout) {
+		const auto wall = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(timeout - timeNow());
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(wall.time_since_epoch()).count();
+	}
+
+	static TimeoutType fromWallClock(std::int64_t wallDeadline) {
+		const std::chrono::nanoseconds remaining{ wallDeadline - std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() };
+		return timeNow() + std::chrono::duration_cast<TimeoutType::duration>(remaining);
+	}
+
+	// A durable timer that fired or got cancelled leaves the log, no need to wait for the sync
+	void forgetDurable(std::uint64_t durableId) {
+#if defined(TIMERS_HAS_POSIX)
+		if (durableId && m_durableLog) {
+			m_durableLog->appendRemove(durableId);
+		}
+#else
+		(void)durableId;
+#endif
+	}
+
+	static constexpr std::uint32_t SnapshotMagic = 0x4E534D54; // "TMSN"
+	static constexpr std::uint32_t SnapshotVersion = 1;
+
+	struct SnapshotHeader {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint64_t count;
+		// system_clock nanoseconds when the snapshot was taken
+		std::int64_t savedAt;
+	};
+
+	// Followed by the payload bytes, padded to 8 bytes
+	struct SnapshotRecord {
+		// Nanoseconds from savedAt, negative when the timer was already due
+		std::int64_t deadlineOffset;
+		CallbackTypeId typeId;
+		std::uint32_t payloadSize;
+		std::uint8_t priority;
+		std::uint8_t reserved[7];
+	};
+
+	static std::size_t snapshotRecordSize(std::size_t payloadSize) {
+		return sizeof(SnapshotRecord) + ((payloadSize + 7) & ~std::size_t{ 7 });
+	}
+
+	const CallbackFactory &callbackFactory(CallbackTypeId typeId) const {
+		const auto lock = lockTimers();
+
+		// Registered factories are never replaced or erased, the reference stays valid
+		const auto it = m_callbackTypes.find(typeId);
+		if (it == m_callbackTypes.end()) {
+			throw std::invalid_argument("unregistered callback type id");
+		}
+		return it->second;
+	}
+
+	// Wall clock timers pass their system_clock deadline too, `timeout` is its steady equivalent
+	TimerId insertPooledTimer(TimerCallback cb, TimeoutType timeout, GroupId group, Priority priority, CallbackTypeId typeId, std::string payload, std::uint64_t durableId, std::int64_t wallDeadline = 0) {
+		TimerId id;
+		// Dropped timers' callbacks are destroyed outside the lock, like a rejected one
+		std::vector<TimerCallback> dropped;
+		std::vector<std::uint64_t> droppedDurableIds;
+
+		{
+			auto lock = lockTimers();
+
+			const Admission admission = admit(lock, toTick(timeout), dropped, droppedDurableIds);
+			if (admission == Admission::Rejected || admission == Admission::TimedOut) {
+				m_stats.rejected.fetch_add(1, std::memory_order_relaxed);
+				id = TimerId{ admission };
+			}
+			else {
+				TimerNode &node = acquireNode();
+				node.callback = std::move(cb);
+				node.priority = priority;
+				if (typeId != NoCallbackType || durableId) {
+					TimerNode::Metadata &metadata = node.ensureMetadata();
+					metadata.typeId = typeId;
+					metadata.payload = std::move(payload);
+					metadata.durableId = durableId;
+				}
+				id = TimerId{ &node, node.generation, admission };
+
+				if (group != NoGroup) {
+					linkToGroup(node, group);
+				}
+
+				if (wallDeadline) {
+					trackWallClock(node, wallDeadline);
+				}
+				pushNode(node, timeout);
+			}
+		}
+
+		for (const std::uint64_t droppedDurableId : droppedDurableIds) {
+			forgetDurable(droppedDurableId);
+		}
+
+		if (!id.valid()) {
+			forgetDurable(durableId);
+			return id;
+		}
+
+		wakeWorkerFor(toTick(timeout));
+
+		return id;
+	}
+
+	// Makes room for one more timer with this deadline according to the admission policy
+	Admission admit(std::unique_lock<std::mutex> &lock, Tick deadline, std::vector<TimerCallback> &dropped, std::vector<std::uint64_t> &droppedDurableIds) {
+		const std::size_t maxTimers = m_options.maxTimers;
+		if (maxTimers == 0 || m_timers.size() < maxTimers) {
+			return Admission::Admitted;
+		}
+
+		switch (m_options.admissionPolicy) {
+		case AdmissionPolicy::Reject:
+			return Admission::Rejected;
+
+		case AdmissionPolicy::Block: {
+			// A callback on the worker or on the backup dispatcher would wait for its own thread to
+			// make room
+			const std::thread::id self = std::this_thread::get_id();
+			if (self == m_worker.get_id() || self == m_backupWorker.get_id()) {
+				return Admission::Rejected;
+			}
+
+			++m_admissionWaiters;
+			const bool admitted = m_admissionCv.wait_for(lock, m_options.admissionTimeout, [&] { return m_timers.size() < maxTimers; });
+			--m_admissionWaiters;
+			return admitted ? Admission::Admitted : Admission::TimedOut;
+		}
+
+		case AdmissionPolicy::DropFarthest:
+			return dropFarthest(deadline, dropped, droppedDurableIds) ? Admission::AdmittedByDropping : Admission::Rejected;
+		}
+
+		return Admission::Rejected;
+	}
+
+	// Drops the pooled timers with the farthest deadlines unless `deadline` is as far as them. The
+	// heap order says nothing about the far end, so this looks at every entry, keeping the batch in
+	// a small min-heap of its own.
+	bool dropFarthest(Tick deadline, std::vector<TimerCallback> &dropped, std::vector<std::uint64_t> &droppedDurableIds) {
+		const std::size_t batchSize = std::max<std::size_t>(m_options.maxTimers / DropBatchDivisor, 1);
+
+		using Candidate = std::pair<Tick, TimerNode *>;
+		std::vector<Candidate> farthest;
+		farthest.reserve(batchSize);
+		const auto nearerFirst = [](const Candidate &a, const Candidate &b) { return a.first > b.first; };
+
+		m_timers.forEach([&](Tick timerDeadline, TimerNode *node) {
+			// Awaiters and slots belong to their owner
+			if (!node->pooled) {
+				return;
+			}
+
+			if (farthest.size() < batchSize) {
+				farthest.emplace_back(timerDeadline, node);
+				std::push_heap(farthest.begin(), farthest.end(), nearerFirst);
+			}
+			else if (timerDeadline > farthest.front().first) {
+				std::pop_heap(farthest.begin(), farthest.end(), nearerFirst);
+				farthest.back() = { timerDeadline, node };
+				std::push_heap(farthest.begin(), farthest.end(), nearerFirst);
+			}
+		});
+
+		if (farthest.empty() || deadline >= farthest.front().first) {
+			return false;
+		}
+
+		for (const auto &[timerDeadline, node] : farthest) {
+			removeNode(*node, true);
+			dropped.push_back(std::move(node->callback));
+			if (node->durableId()) {
+				droppedDurableIds.push_back(node->durableId());
+			}
+			releaseNode(*node);
+		}
+
+		return true;
+	}
+
+	void notifyWorker() {
+		m_parker.wake();
+
+		// The backup dispatcher waits on the condition while the worker is stuck
+		if (m_options.failoverOnSlowCallback) {
+			m_cv.notify_all();
+		}
+	}
+
+	// Wraps every callback the worker runs so the watchdog can see it
+	template <typename Run>
+	void runWatched(const char *callbackType, Tick deadline, Priority priority, GroupId group, Run &&run) {
+		if (!m_watchdog.joinable()) {
+			run();
+			return;
+		}
+
+		{
+			std::lock_guard lock(m_watchdogMtx);
+			m_running = RunningCallback{ timeNow(), ++m_runningSerial, callbackType, deadline, priority, group };
+		}
+
+		run();
+
+		{
+			std::lock_guard lock(m_watchdogMtx);
+			m_running.reset();
+		}
+
+		if (!m_backupWorker.joinable()) {
+			return;
+		}
+
+		// The worker is back, the backup dispatcher steps aside
+		const auto lock = lockTimers();
+		if (m_workerStalled) {
+			m_workerStalled = false;
+			m_cv.notify_all();
+		}
+	}
+
+	void watchdogLoop(std::stop_token stopToken) {
+		const auto period = std::max<std::chrono::steady_clock::duration>(m_options.callbackBudget / 4, 1ms);
+		std::uint64_t reportedSerial = 0;
+
+		std::unique_lock lock(m_watchdogMtx);
+		while (!stopToken.stop_requested()) {
+			m_watchdogCv.wait_for(lock, period);
+
+			if (!m_running || m_running->serial == reportedSerial) {
+				continue;
+			}
+
+			const auto running = timeNow() - m_running->start;
+			if (running < m_options.callbackBudget) {
+				continue;
+			}
+
+			reportedSerial = m_running->serial;
+			const SlowCallbackReport report{ m_running->callbackType, running, fromTick(m_running->deadline), m_running->priority, m_running->group };
+			lock.unlock();
+
+			if (m_options.failoverOnSlowCallback) {
+				// Only while the same callback still runs. One that returned meanwhile already reset
+				// m_running, and the worker only clears the flag after that, so it would stay set
+				const auto timersLock = lockTimers();
+				std::lock_guard runningLock(m_watchdogMtx);
+				if (m_running && m_running->serial == reportedSerial) {
+					m_workerStalled = true;
+					m_backupCv.notify_all();
+				}
+			}
+
+			if (m_options.onSlowCallback) {
+				m_options.onSlowCallback(report);
+			}
+			else {
+				std::cerr << "TimersManager: callback " << report.callbackType << " running for "
+					<< std::chrono::duration_cast<std::chrono::milliseconds>(report.running).count() << "ms (budget "
+					<< m_options.callbackBudget.count() << "ms)\n";
+			}
+
+			lock.lock();
+		}
+	}
+
+	// Fires due pooled timers while the worker is stuck in a callback, first the unrun rest of the
+	// worker's batch, then the heap. Awaiters and slots wait for the worker, only one of them may
+	// run at a time, but the pooled timers due behind them are still taken.
+	void backupLoop(std::stop_token stopToken) {
+		applyThreadOptions();
+
+		// Due awaiters and slots taken off the top to reach the pooled timers behind them
+		std::vector<std::pair<Tick, TimerNode *>> setAside;
+
+		auto lock = lockTimers();
+
+		while (!stopToken.stop_requested()) {
+			if (!m_workerStalled) {
+				m_backupCv.wait(lock, [&] { return m_workerStalled || stopToken.stop_requested(); });
+				continue;
+			}
+
+			// The worker waits for the stolen ones before it reuses the batch
+			if (DueTimer *due = m_dueQueue.steal()) {
+				lock.unlock();
+				runOnBackup(due->callback, due->node, due->generation, due->durableId);
+				m_stolenDone.fetch_add(1, std::memory_order_release);
+				m_stolenDone.notify_one();
+				lock.lock();
+				continue;
+			}
+
+			const Tick now = toTick(timeNow());
+			while (!m_timers.empty() && m_timers.topDeadline() <= now && !m_timers.top()->pooled) {
+				const Tick deadline = m_timers.topDeadline();
+				setAside.emplace_back(deadline, m_timers.pop());
+			}
+
+			TimerNode *node = nullptr;
+			const bool due = !m_timers.empty() && m_timers.topDeadline() <= now;
+			const Tick nextDeadline = m_timers.empty() ? NoDeadline : m_timers.topDeadline();
+			if (due) {
+				node = popNode();
+			}
+
+			// Back in place before anyone else sees the heap
+			for (const auto &[deadline, aside] : setAside) {
+				m_timers.push(deadline, aside);
+			}
+			if (!setAside.empty()) {
+				setAside.clear();
+				publishHeapState();
+			}
+
+			if (!node) {
+				if (nextDeadline != NoDeadline) {
+					m_cv.wait_until(lock, fromTick(nextDeadline));
+				}
+				else {
+					m_cv.wait(lock);
+				}
+				continue;
+			}
+
+			TimerCallback cb = std::move(node->callback);
+			const std::uint64_t durableId = node->durableId();
+			const std::uint64_t generation = node->generation;
+			releaseNode(*node);
+
+			lock.unlock();
+			runOnBackup(cb, node, generation, durableId);
+			m_stats.fired.fetch_add(1, std::memory_order_relaxed);
+			lock.lock();
+		}
+	}
+
+	// Not through runWatched(), the watchdog only watches the worker
+	void runOnBackup(TimerCallback &callback, const TimerNode *node, std::uint64_t generation, std::uint64_t durableId) {
+		const TimeoutType start = timeNow();
+		TIMERS_PROBE(callback_start, node, generation);
+		trace(TimerTracer::Event::CallbackStart, node, generation);
+		callback();
+		TIMERS_PROBE(callback_end, node, generation);
+		trace(TimerTracer::Event::CallbackEnd, node, generation);
+		addCallbackTime(start);
+		forgetDurable(durableId);
+	}
+
+	// Every removal from the heap goes through these two to keep the wall clock bookkeeping right
+	TimerNode *popNode() {
+		TimerNode *node = m_timers.pop();
+		forgetWallClock(*node);
+		publishHeapState();
+		TIMERS_PROBE(dequeue, node, node->generation);
+		trace(TimerTracer::Event::Dequeue, node, node->generation);
+		if (m_options.recorder) {
+			m_options.recorder->record(WorkloadRecorder::Event::Fire, node);
+		}
+		return node;
+	}
+
+	// Only cancellations and admission drops remove timers that are not due
+	void removeNode(TimerNode &node, bool dropped = false) {
+		m_timers.erase(node.heapIndex);
+		forgetWallClock(node);
+		(dropped ? m_stats.dropped : m_stats.cancelled).fetch_add(1, std::memory_order_relaxed);
+		publishHeapState();
+		TIMERS_PROBE(cancel, &node, node.generation);
+		trace(TimerTracer::Event::Cancel, &node, node.generation);
+		if (m_options.recorder) {
+			m_options.recorder->record(WorkloadRecorder::Event::Cancel, &node);
+		}
+	}
+
+	void trace(TimerTracer::Event event, const TimerNode *node, std::uint64_t generation) {
+		if (m_tracer) {
+			m_tracer->record(event, node, generation);
+		}
+	}
+
+	// Called with the lock held after every change of the heap
+	void publishHeapState() {
+		const std::size_t size = m_timers.size();
+		m_stats.pending.store(size, std::memory_order_relaxed);
+		m_stats.nextDeadline.store(m_timers.empty() ? NoDeadline : m_timers.topDeadline(), std::memory_order_relaxed);
+
+		if (size > m_stats.maxHeapSize.load(std::memory_order_relaxed)) {
+			m_stats.maxHeapSize.store(size, std::memory_order_relaxed);
+		}
+
+		// Every removal makes room for one blocked insert
+		if (m_admissionWaiters > 0 && size < m_options.maxTimers) {
+			m_admissionCv.notify_one();
+		}
+	}
+
+	// Uncontended acquisitions are not timed
+	std::unique_lock<std::mutex> lockTimers() const {
+		std::unique_lock lock(m_mtx, std::try_to_lock);
+
+		if (!lock.owns_lock()) {
+			const TimeoutType start = timeNow();
+			lock.lock();
+			m_stats.lockWaitNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(timeNow() - start).count(), std::memory_order_relaxed);
+		}
+
+		return lock;
+	}
+
+	void addCallbackTime(TimeoutType start) {
+		m_stats.callbackNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(timeNow() - start).count(), std::memory_order_relaxed);
+	}
+
+	void trackWallClock(TimerNode &node, std::int64_t wallDeadline) {
+		node.ensureMetadata().wallDeadline = wallDeadline;
+		++m_wallClockTimers;
+#if defined(TIMERS_HAS_LINUX)
+		watchClockSteps();
+#endif
+	}
+
+#if defined(TIMERS_HAS_LINUX)
+	// Started with the first wall clock timer, the worker keeps polling the clocks without it
+	void watchClockSteps() {
+		if (m_clockStepWatcher || m_clockStepWatchFailed) {
+			return;
+		}
+
+		try {
+			m_clockStepWatcher = std::make_unique<ClockStepWatcher>([this] {
+				wakeForClockStep();
+			});
+		}
+		catch (const std::system_error &e) {
+			m_clockStepWatchFailed = true;
+			std::cerr << "TimersManager: " << e.what() << ", polling the wall clock instead\n";
+		}
+	}
+
+	void wakeForClockStep() {
+		{
+			const auto lock = lockTimers();
+			m_clockStepped = true;
+		}
+		notifyWorker();
+	}
+#endif
+
+	bool clockStepsWatched() const {
+#if defined(TIMERS_HAS_LINUX)
+		return m_clockStepWatcher != nullptr;
+#else
+		return false;
+#endif
+	}
+
+	void forgetWallClock(TimerNode &node) {
+		if (node.wallDeadline()) {
+			node.metadata->wallDeadline = 0;
+			--m_wallClockTimers;
+		}
+	}
+
+	// Called by the worker with the lock held. A changed offset between the clocks means the wall
+	// clock was stepped, every wall clock deadline gets a new steady deadline.
+	void checkClockJump() {
+		const std::int64_t steadyNow = std::chrono::duration_cast<std::chrono::nanoseconds>(timeNow().time_since_epoch()).count();
+		const std::int64_t offset = toWallNanoseconds(std::chrono::system_clock::now()) - steadyNow;
+		const std::int64_t previousOffset = std::exchange(m_clockOffset, offset);
+
+		if (m_wallClockTimers == 0 || std::abs(offset - previousOffset) < std::chrono::nanoseconds{ ClockJumpThreshold }.count()) {
+			return;
+		}
+
+		std::vector<TimerNode *> wallClockNodes;
+		m_timers.forEach([&](Tick, TimerNode *node) {
+			if (node->wallDeadline()) {
+				wallClockNodes.push_back(node);
+			}
+		});
+
+		for (TimerNode *node : wallClockNodes) {
+			m_timers.update(node->heapIndex, toTick(fromWallClock(node->wallDeadline())));
+		}
+		publishHeapState();
+	}
+
+	TimerNode &acquireNode() {
+		if (m_freeNodes.empty()) {
+			TimerNode &node = m_nodePool.emplace_back();
+			node.pooled = true;
+			return node;
+		}
+
+		TimerNode &node = *m_freeNodes.back();
+		m_freeNodes.pop_back();
+		return node;
+	}
+
+	void linkToGroup(TimerNode &node, GroupId group) {
+		TimerNode *&head = m_groupHeads[group];
+
+		node.group = group;
+		node.groupPrev = nullptr;
+		node.groupNext = head;
+		if (head) {
+			head->groupPrev = &node;
+		}
+		head = &node;
+	}
+
+	void unlinkFromGroup(TimerNode &node) {
+		if (node.groupPrev) {
+			node.groupPrev->groupNext = node.groupNext;
+		}
+		else if (node.groupNext) {
+			m_groupHeads[node.group] = node.groupNext;
+		}
+		else {
+			m_groupHeads.erase(node.group);
+		}
+
+		if (node.groupNext) {
+			node.groupNext->groupPrev = node.groupPrev;
+		}
+
+		node.group = NoGroup;
+		node.groupPrev = node.groupNext = nullptr;
+	}
+
+	void releaseNode(TimerNode &node) {
+		if (node.group != NoGroup) {
+			unlinkFromGroup(node);
+		}
+
+		node.callback = nullptr;
+		node.priority = Priority::Normal;
+		node.metadata.reset();
+		++node.generation;
+		m_freeNodes.push_back(&node);
+	}
+
+	// Returns the deadline to pass to wakeWorkerFor() once the lock is released
+	Tick pushNode(TimerNode &node, TimeoutType timeout) {
+		// Add new timer and heapify
+		m_timers.push(toTick(timeout), &node);
+		m_stats.inserted.fetch_add(1, std::memory_order_relaxed);
+		publishHeapState();
+		TIMERS_PROBE(insert, &node, node.generation);
+		trace(TimerTracer::Event::Insert, &node, node.generation);
+		if (m_options.recorder) {
+			m_options.recorder->record(WorkloadRecorder::Event::Insert, &node, timeout - timeNow(), static_cast<std::uint8_t>(node.priority));
+		}
+
+		return toTick(timeout);
+	}
+
+	// Called without the lock after the heap got a timer with this deadline. The check needs no lock:
+	// a worker that parked before the insert published how long it sleeps, one that parks after it
+	// sees the timer in the heap. An awake worker is never notified, a stuck one leaves the new timer
+	// to the backup dispatcher.
+	void wakeWorkerFor(Tick deadline) {
+		if (m_parker.parkedPast(deadline) || m_workerStalled.load(std::memory_order_seq_cst)) {
+			notifyWorker();
+		}
+	}
+
+	void insertNode(TimerNode &node, TimeoutType timeout) {
+		{
+			const auto lock = lockTimers();
+			pushNode(node, timeout);
+		}
+
+		wakeWorkerFor(toTick(timeout));
+	}
+
+	void armSlot(TimerNode &node, TimeoutType deadline, std::int64_t wallDeadline) {
+		{
+			const auto lock = lockTimers();
+
+			forgetWallClock(node);
+			if (wallDeadline) {
+				trackWallClock(node, wallDeadline);
+			}
+
+			if (!node.pending()) {
+				pushNode(node, deadline);
+			}
+			else {
+				m_timers.update(node.heapIndex, toTick(deadline));
+				publishHeapState();
+			}
+		}
+
+		wakeWorkerFor(toTick(deadline));
+	}
+
+	bool disarmSlot(TimerNode &node) {
+		const auto lock = lockTimers();
+
+		if (!node.pending()) {
+			return false;
+		}
+
+		removeNode(node);
+		return true;
+	}
+
+	void detachSlot(TimerNode &node) {
+		auto lock = lockTimers();
+
+		if (node.pending()) {
+			removeNode(node);
+		}
+
+		// A slot destroyed from its own callback doesn't wait for itself
+		if (std::this_thread::get_id() != m_worker.get_id()) {
+			m_slotDoneCv.wait(lock, [&] { return m_runningSlot != &node; });
+		}
+	}
+
+	void cancelNode(TimerNode &node) {
+		const auto lock = lockTimers();
+
+		if (node.pending()) {
+			removeNode(node);
+		}
+		// Popped but not resumed yet, the worker checks this before resuming the destroyed frame
+		else if (m_resumingAwaiter == &node) {
+			m_resumingAwaiter = nullptr;
+		}
+	}
+
+	// Runs what the shutdown policy asks for on a few threads, the worker is already gone by now.
+	// Awaiters and slots are never drained, their owners may be gone.
+	void drainPendingTimers() {
+		if (m_options.shutdownPolicy == ShutdownPolicy::Discard) {
+			return;
+		}
+
+		const TimeoutType drainDeadline = timeNow() + m_options.drainDeadline;
+		std::vector<TimerCallback> callbacks;
+		std::vector<std::uint64_t> durableIds;
+
+		{
+			const auto lock = lockTimers();
+
+			const Tick now = toTick(timeNow());
+			while (!m_timers.empty()) {
+				if (m_options.shutdownPolicy == ShutdownPolicy::RunDue && m_timers.topDeadline() > now) {
+					break;
+				}
+
+				TimerNode *node = popNode();
+				if (node->pooled) {
+					callbacks.push_back(std::move(node->callback));
+					durableIds.push_back(node->durableId());
+					releaseNode(*node);
+				}
+			}
+		}
+
+		std::atomic<std::size_t> nextBatch{ 0 };
+		std::atomic<std::size_t> executed{ 0 };
+
+		const auto drain = [&] {
+			while (true) {
+				const std::size_t begin = nextBatch.fetch_add(DrainBatchSize, std::memory_order_relaxed);
+				if (begin >= callbacks.size()) {
+					return;
+				}
+
+				const std::size_t end = std::min(begin + DrainBatchSize, callbacks.size());
+				for (std::size_t i = begin; i < end; ++i) {
+					if (timeNow() >= drainDeadline) {
+						return;
+					}
+
+					const TimeoutType start = timeNow();
+					callbacks[i]();
+					addCallbackTime(start);
+					forgetDurable(durableIds[i]);
+					executed.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		const std::size_t batches = (callbacks.size() + DrainBatchSize - 1) / DrainBatchSize;
+		const std::size_t threads = std::min<std::size_t>(m_options.drainThreads ? m_options.drainThreads : hardwareThreads, batches);
+
+		{
+			// The destructor's thread is one of the drain threads
+			std::vector<std::jthread> helpers;
+			for (std::size_t i = 1; i < threads; ++i) {
+				helpers.emplace_back(drain);
+			}
+			drain();
+		}
+
+		m_stats.fired.fetch_add(executed.load(), std::memory_order_relaxed);
+		std::cout << "TimersManager drained " << executed.load() << "/" << callbacks.size() << " pending timers\n";
+	}
+
+	// Runs a due timer taken from the heap of owner, which is this manager unless it was stolen
+	void runDue(DueTimer &due, TimersManager &owner) {
+		TIMERS_PROBE(callback_start, due.node, due.generation);
+		trace(TimerTracer::Event::CallbackStart, due.node, due.generation);
+		runWatched(due.callback.target_type().name(), due.deadline, due.priority, due.group, due.callback);
+		TIMERS_PROBE(callback_end, due.node, due.generation);
+		trace(TimerTracer::Event::CallbackEnd, due.node, due.generation);
+
+		// Logged only after running, a crash in between runs it again after recovery
+		owner.forgetDurable(due.durableId);
+	}
+
+	// Puts the batch in this worker's deque and wakes the rest of the group if asked. The worker
+	// pops the highest priorities from the bottom while thieves and the backup dispatcher take the
+	// latest deadlines from the top.
+	void dispatchShared(std::span<std::vector<DueTimer>> lanes, std::size_t batchSize, bool wakePeers) {
+		m_stolenDone.store(0, std::memory_order_relaxed);
+
+		for (auto lane = lanes.rbegin(); lane != lanes.rend(); ++lane) {
+			for (auto due = lane->rbegin(); due != lane->rend(); ++due) {
+				m_dueQueue.push(&*due);
+			}
+		}
+
+		if (wakePeers) {
+			m_options.stealGroup->wakeOthers(*this);
+		}
+
+		std::size_t ranHere = 0;
+		while (DueTimer *due = m_dueQueue.pop()) {
+			runDue(*due, *this);
+			++ranHere;
+		}
+
+		// Thieves still running a stolen callback point into the lanes
+		const std::size_t stolen = batchSize - ranHere;
+		for (std::size_t done = m_stolenDone.load(std::memory_order_acquire); done < stolen; done = m_stolenDone.load(std::memory_order_acquire)) {
+			m_stolenDone.wait(done, std::memory_order_acquire);
+		}
+	}
+
+	void wakeForStealing() {
+		{
+			const auto lock = lockTimers();
+			m_stealRequested = true;
+		}
+		notifyWorker();
+	}
+
+	void stealFromPeers() {
+		std::shared_lock lock(m_options.stealGroup->m_mtx);
+
+		for (TimersManager *peer : m_options.stealGroup->m_members) {
+			if (peer == this) {
+				continue;
+			}
+
+			while (!peer->m_dueQueue.empty()) {
+				DueTimer *due = peer->m_dueQueue.steal();
+				if (!due) {
+					continue;
+				}
+
+				runDue(*due, *peer);
+				peer->m_stolenDone.fetch_add(1, std::memory_order_release);
+				peer->m_stolenDone.notify_one();
+			}
+		}
+	}
+
+	// Called at the start of the worker threads
+	void applyThreadOptions() {
+#if defined(TIMERS_HAS_LINUX)
+		const auto warn = [](const char *what, int error) {
+			std::cerr << "TimersManager: " << what << " failed: " << std::strerror(error) << "\n";
+		};
+
+		const pthread_t self = ::pthread_self();
+
+		if (!m_options.workerCpus.empty()) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			for (const unsigned cpu : m_options.workerCpus) {
+				if (cpu < CPU_SETSIZE) {
+					CPU_SET(cpu, &cpus);
+				}
+			}
+
+			if (const int error = ::pthread_setaffinity_np(self, sizeof(cpus), &cpus)) {
+				warn("pthread_setaffinity_np", error);
+			}
+		}
+
+		if (m_options.workerScheduling != SchedulingPolicy::Default) {
+			const int policy = m_options.workerScheduling == SchedulingPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+			sched_param param{};
+			param.sched_priority = std::clamp(m_options.workerPriority, ::sched_get_priority_min(policy), ::sched_get_priority_max(policy));
+
+			if (const int error = ::pthread_setschedparam(self, policy, &param)) {
+				warn("pthread_setschedparam", error);
+			}
+		}
+
+		if (!m_options.workerName.empty()) {
+			const std::string name = m_options.workerName.substr(0, 15);
+			if (const int error = ::pthread_setname_np(self, name.c_str())) {
+				warn("pthread_setname_np", error);
+			}
+		}
+
+		if (m_options.lockWorkerStack) {
+			pthread_attr_t attr;
+			if (const int error = ::pthread_getattr_np(self, &attr)) {
+				warn("pthread_getattr_np", error);
+				return;
+			}
+
+			void *stack = nullptr;
+			std::size_t stackSize = 0;
+			::pthread_attr_getstack(&attr, &stack, &stackSize);
+			::pthread_attr_destroy(&attr);
+
+			if (::mlock(stack, stackSize) != 0) {
+				warn("mlock", errno);
+			}
+		}
+#endif
+	}
+
+	void workerLoop(std::stop_token stopToken) {
+		applyThreadOptions();
+
+		std::cout << "TimersManager worker started\n";
+
+		// Due timers taken from the heap, one vector per priority. The lower lanes are carried over
+		// while a backlog is taken batch by batch, its rest may hold higher priorities.
+		std::array<std::vector<DueTimer>, PriorityLanes> lanes;
+		bool deferred = false;
+
+		while (true) {
+			std::coroutine_handle<> continuation;
+			TimerNode *slot = nullptr;
+			bool stealRequested = false;
+			Tick singleDeadline = 0;
+			const TimerNode *singleNode = nullptr;
+			std::uint64_t singleGeneration = 0;
+			std::size_t batchSize = 0;
+
+			{
+				auto lock = lockTimers();
+
+				if (!m_stealRequested && !m_clockStepped && !deferred && !stopToken.stop_requested()) {
+					Tick wakeAt = m_timers.empty() ? DeadlineParker::Forever : m_timers.topDeadline();
+
+					// A sleep across a clock step would miss it, unless the step wakes the worker
+					if (m_wallClockTimers > 0 && !clockStepsWatched()) {
+						wakeAt = std::min(wakeAt, toTick(timeNow() + WallClockCheckInterval));
+					}
+
+					if (wakeAt > toTick(timeNow())) {
+						const std::uint32_t ticket = m_parker.prepare(wakeAt);
+						lock.unlock();
+						m_parker.park(ticket, wakeAt);
+						lock.lock();
+					}
+				}
+
+				// Pending timers are left to drainPendingTimers(), which applies the shutdown policy
+				if (stopToken.stop_requested()) {
+					break;
+				}
+
+				m_stats.wakeups.fetch_add(1, std::memory_order_relaxed);
+				stealRequested = std::exchange(m_stealRequested, false);
+
+				m_clockStepped = false;
+				checkClockJump();
+
+				const Tick now = toTick(timeNow());
+#if defined(TIMERS_COMPACT_DEADLINES)
+				m_timers.advance(now);
+#endif
+
+				while (!m_timers.empty() && m_timers.topDeadline() <= now && batchSize < MaxBatchSize) {
+					TimerNode *node = m_timers.top();
+
+					// Awaiters and slots belong to their users and may go away, they are taken one at a time
+					if (!node->pooled) {
+						if (batchSize == 0) {
+							singleDeadline = m_timers.topDeadline();
+							singleNode = node;
+							singleGeneration = node->generation;
+							popNode();
+
+							if (node->continuation) {
+								continuation = std::exchange(node->continuation, {});
+								m_resumingAwaiter = node;
+							}
+							else {
+								// Slots keep their callback, it runs in place
+								slot = node;
+								m_runningSlot = slot;
+							}
+						}
+						break;
+					}
+
+					lanes[static_cast<std::size_t>(node->priority)].push_back(DueTimer{ std::move(node->callback), m_timers.topDeadline(), node->group, node->durableId(), node, node->generation, node->priority });
+					popNode();
+					releaseNode(*node);
+					++batchSize;
+				}
+
+				if (batchSize == 0 && !deferred && !continuation && !slot && !stealRequested) {
+					m_stats.spuriousWakeups.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+
+				// Cut off by the batch size, only the highest lane runs before the rest is taken
+				deferred = batchSize == MaxBatchSize && !m_timers.empty() && m_timers.topDeadline() <= now;
+			}
+
+			const std::span<std::vector<DueTimer>> runLanes(lanes.data(), deferred ? 1 : PriorityLanes);
+			std::size_t runSize = 0;
+			for (const auto &lane : runLanes) {
+				runSize += lane.size();
+			}
+
+			const TimeoutType callbacksStart = timeNow();
+
+			// The backup dispatcher can only take over the rest of a batch it can steal from
+			const bool wakePeers = m_options.stealGroup && runSize > StealThreshold;
+			if (wakePeers || (m_options.failoverOnSlowCallback && m_options.callbackBudget.count() > 0 && runSize > 0)) {
+				dispatchShared(runLanes, runSize, wakePeers);
+			}
+			else {
+				for (auto &lane : runLanes) {
+					for (DueTimer &due : lane) {
+						runDue(due, *this);
+					}
+				}
+			}
+
+			for (auto &lane : runLanes) {
+				lane.clear();
+			}
+
+			if (continuation) {
+				// Destroyed while the batch ran, its frame is gone
+				const auto lock = lockTimers();
+				if (std::exchange(m_resumingAwaiter, nullptr) != singleNode) {
+					continuation = {};
+				}
+			}
+
+			if (continuation) {
+				// The awaiter's node may be gone once the coroutine resumed, only its address is traced
+				TIMERS_PROBE(callback_start, singleNode, singleGeneration);
+				trace(TimerTracer::Event::CallbackStart, singleNode, singleGeneration);
+				runWatched("coroutine", singleDeadline, Priority::Normal, NoGroup, [&] { continuation.resume(); });
+				TIMERS_PROBE(callback_end, singleNode, singleGeneration);
+				trace(TimerTracer::Event::CallbackEnd, singleNode, singleGeneration);
+			}
+			else if (slot) {
+				TIMERS_PROBE(callback_start, singleNode, singleGeneration);
+				trace(TimerTracer::Event::CallbackStart, singleNode, singleGeneration);
+				runWatched(slot->callback.target_type().name(), singleDeadline, slot->priority, NoGroup, slot->callback);
+				TIMERS_PROBE(callback_end, singleNode, singleGeneration);
+				trace(TimerTracer::Event::CallbackEnd, singleNode, singleGeneration);
+
+				{
+					const auto lock = lockTimers();
+					m_runningSlot = nullptr;
+				}
+				m_slotDoneCv.notify_all();
+			}
+
+			addCallbackTime(callbacksStart);
+			m_stats.fired.fetch_add(runSize + (continuation || slot ? 1 : 0), std::memory_order_relaxed);
+
+			if (stealRequested) {
+				stealFromPeers();
+			}
+		}
+
+		// Taken before the stop but held back behind a backlog
+		for (auto &lane : lanes) {
+			for (DueTimer &due : lane) {
+				runDue(due, *this);
+			}
+			m_stats.fired.fetch_add(lane.size(), std::memory_order_relaxed);
+		}
+
+		std::cout << "TimersManager worker exiting...\n";
+	}
+
+private:
+	const Options m_options;
+	mutable std::mutex m_mtx;
+	// Only the backup dispatcher waits on the condition, the worker parks
+	std::condition_variable m_cv;
+	DeadlineParker m_parker;
+	std::condition_variable m_slotDoneCv;
+	const TimerNode *m_runningSlot{ nullptr };
+	// Awaiter popped by the worker, reset when its coroutine is destroyed before it is resumed
+	const TimerNode *m_resumingAwaiter{ nullptr };
+	DeadlineHeap m_timers;
+	std::deque<TimerNode> m_nodePool;
+	std::vector<TimerNode *> m_freeNodes;
+	std::unordered_map<GroupId, TimerNode *> m_groupHeads;
+	std::unordered_map<CallbackTypeId, CallbackFactory> m_callbackTypes;
+	std::size_t m_wallClockTimers{ 0 };
+	std::int64_t m_clockOffset{ 0 };
+	bool m_clockStepped{ false };
+#if defined(TIMERS_HAS_LINUX)
+	std::unique_ptr<ClockStepWatcher> m_clockStepWatcher;
+	bool m_clockStepWatchFailed{ false };
+#endif
+	mutable StatCounters m_stats;
+	std::unique_ptr<TimerTracer> m_tracer;
+	// Inserts blocked by AdmissionPolicy::Block wait on the condition
+	std::condition_variable m_admissionCv;
+	std::size_t m_admissionWaiters{ 0 };
+
+	// Watchdog state, m_workerStalled is written with m_mtx held and the rest is guarded by m_watchdogMtx.
+	// When both are needed m_mtx comes first.
+	std::mutex m_watchdogMtx;
+	std::condition_variable m_watchdogCv;
+	std::optional<RunningCallback> m_running;
+	std::uint64_t m_runningSerial{ 0 };
+	std::atomic<bool> m_workerStalled{ false };
+	std::condition_variable m_backupCv;
+	std::jthread m_watchdog;
+	std::jthread m_backupWorker;
+#if defined(TIMERS_HAS_POSIX)
+	std::unique_ptr<DurableTimerLog> m_durableLog;
+#endif
+	std::atomic<GroupId> m_nextGroup{ NoGroup + 1 };
+
+	// Due timers of the batch being dispatched, only used with a steal group
+	WorkStealingDeque<DueTimer> m_dueQueue{ MaxBatchSize };
+	std::atomic<std::size_t> m_stolenDone{ 0 };
+	bool m_stealRequested{ false };
+
+	std::jthread m_worker;
+
+public:
+	class StealGroup {
+	public:
+		StealGroup() = default;
+		StealGroup(const StealGroup &) = delete;
+		StealGroup &operator=(const StealGroup &) = delete;
+
+	private:
+		friend class TimersManager;
+
+		void wakeOthers(const TimersManager &owner) {
+			std::shared_lock lock(m_mtx);
+			for (TimersManager *member : m_members) {
+				if (member != &owner) {
+					member->wakeForStealing();
+				}
+			}
+		}
+
+		// Exclusive while a manager joins or leaves, thieves hold it shared
+		std::shared_mutex m_mtx;
+		std::vector<TimersManager *> m_members;
+	};
+};
+
+#if defined(TIMERS_HAS_LINUX)
+namespace numa_detail {
+	// Parses sysfs cpu lists like "0-3,8-11"
+	inline std::vector<unsigned> parseCpuList(std::string_view list) {
+		std::vector<unsigned> cpus;
+
+		while (!list.empty()) {
+			const std::size_t comma = list.find(',');
+			const std::string_view range = list.substr(0, comma);
+			list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+
+			const std::size_t dash = range.find('-');
+			const unsigned first = static_cast<unsigned>(std::strtoul(std::string{ range.substr(0, dash) }.c_str(), nullptr, 10));
+			const unsigned last = dash == std::string_view::npos ? first : static_cast<unsigned>(std::strtoul(std::string{ range.substr(dash + 1) }.c_str(), nullptr, 10));
+			for (unsigned cpu = first; cpu <= last; ++cpu) {
+				cpus.push_back(cpu);
+			}
+		}
+
+		return cpus;
+	}
+
+	// CPUs of every NUMA node with at least one CPU, empty when the kernel doesn't expose the topology
+	inline std::vector<std::vector<unsigned>> nodeCpus() {
+		std::vector<std::pair<unsigned, std::vector<unsigned>>> nodes;
+
+		std::error_code error;
+		for (const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+			const std::string name = entry.path().filename().string();
+			if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || name.find_first_not_of("0123456789", 4) != std::string::npos) {
+				continue;
+			}
+
+			std::ifstream file(entry.path() / "cpulist");
+			std::string list;
+			if (std::getline(file, list) && !list.empty()) {
+				nodes.emplace_back(static_cast<unsigned>(std::stoul(name.substr(4))), parseCpuList(list));
+			}
+		}
+
+		std::sort(nodes.begin(), nodes.end());
+
+		std::vector<std::vector<unsigned>> cpus;
+		for (auto &node : nodes) {
+			cpus.push_back(std::move(node.second));
+		}
+		return cpus;
+	}
+}
+#endif
+
+// One TimersManager per NUMA node. Timers go to the shard of the node the inserting thread runs
+// on, and its worker is pinned to that node, so the heap is only touched from local CPUs and its
+// pages are allocated on the node by the first touch policy. Without NUMA information there is a
+// single shard.
+class ShardedTimersManager {
+public:
+	class TimerId {
+	public:
+		TimerId() = default;
+
+		bool valid() const {
+			return m_id.valid();
+		}
+
+		TimersManager::Admission admission() const {
+			return m_id.admission();
+		}
+
+	private:
+		friend class ShardedTimersManager;
+
+		TimerId(std::size_t shard, TimersManager::TimerId id)
+			: m_shard(shard)
+			, m_id(id) {
+
+		}
+
+		std::size_t m_shard{ 0 };
+		TimersManager::TimerId m_id;
+	};
+
+	// The worker options apply to every shard, their CPU set is replaced by the node's
+	explicit ShardedTimersManager(const TimersManager::Options &options = {}) {
+#if defined(TIMERS_HAS_LINUX)
+		const auto nodes = numa_detail::nodeCpus();
+		for (std::size_t node = 0; node < nodes.size(); ++node) {
+			for (const unsigned cpu : nodes[node]) {
+				if (cpu >= m_cpuToShard.size()) {
+					m_cpuToShard.resize(cpu + 1, 0);
+				}
+				m_cpuToShard[cpu] = node;
+			}
+		}
+
+		if (nodes.size() > 1) {
+			m_shards.resize(nodes.size());
+			const auto stealGroup = std::make_shared<TimersManager::StealGroup>();
+
+			for (std::size_t node = 0; node < nodes.size(); ++node) {
+				TimersManager::Options shardOptions = options;
+				shardOptions.workerCpus = nodes[node];
+				shardOptions.workerName = (options.workerName.empty() ? "timers" : options.workerName) + "-n" + std::to_string(node);
+				shardOptions.stealGroup = stealGroup;
+
+				// Built from a thread on the node so the manager itself lands in local memory
+				std::jthread([&] {
+					cpu_set_t cpus;
+					CPU_ZERO(&cpus);
+					for (const unsigned cpu : nodes[node]) {
+						CPU_SET(cpu, &cpus);
+					}
+					::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+
+					m_shards[node] = std::make_unique<TimersManager>(shardOptions);
+				}).join();
+			}
+			return;
+		}
+#endif
+		m_shards.push_back(std::make_unique<TimersManager>(options));
+	}
+
+	template <typename Timeout>
+	TimerId insertTimer(TimersManager::TimerCallback cb, Timeout timeout, TimersManager::Priority priority = TimersManager::Priority::Normal) {
+		const std::size_t shard = currentShard();
+		return TimerId{ shard, m_shards[shard]->insertTimer(std::move(cb), timeout, TimersManager::NoGroup, priority) };
+	}
+
+	bool cancelTimer(TimerId id) {
+		return id.valid() && m_shards[id.m_shard]->cancelTimer(id.m_id);
+	}
+
+	std::size_t shardCount() const {
+		return m_shards.size();
+	}
+
+	TimersManager &shard(std::size_t index) {
+		return *m_shards[index];
+	}
+
+private:
+	std::size_t currentShard() const {
+#if defined(TIMERS_HAS_LINUX)
+		if (m_shards.size() > 1) {
+			const int cpu = ::sched_getcpu();
+			if (cpu >= 0 && static_cast<std::size_t>(cpu) < m_cpuToShard.size()) {
+				return m_cpuToShard[cpu];
+			}
+		}
+#endif
+		return 0;
+	}
+
+	std::vector<std::unique_ptr<TimersManager>> m_shards;
+	std::vector<std::size_t> m_cpuToShard;
+};
+
+struct RetryPolicy {
+	enum class Backoff {
+		// Uniform in [0, min(cap, base * 2^retry)]
+		ExponentialJitter,
+		// Uniform in [base, previous delay * 3], capped
+		DecorrelatedJitter
+	};
+
+	Backoff backoff{ Backoff::DecorrelatedJitter };
+	std::chrono::milliseconds baseDelay{ 100 };
+	std::chrono::milliseconds maxDelay{ 10'000 };
+	unsigned maxAttempts{ 5 };
+};
+
+// Retry budget shared by every operation going to the same target. Each first attempt earns
+// `retryRatio` of a retry and each retry spends a whole one, so a failing target can't be hit
+// with more than roughly (1 + retryRatio) times the normal load.
+class RetryBudget {
+public:
+	explicit RetryBudget(double retryRatio = 0.1, unsigned maxRetries = 10)
+		: m_depositPerRequest(static_cast<std::int64_t>(retryRatio * Scale))
+		, m_maxBalance(static_cast<std::int64_t>(maxRetries) * Scale)
+		, m_balance(m_maxBalance) {
+
+	}
+
+	void onRequest() {
+		std::int64_t balance = m_balance.load(std::memory_order_relaxed);
+		while (!m_balance.compare_exchange_weak(balance, std::min(m_maxBalance, balance + m_depositPerRequest), std::memory_order_relaxed)) {
+		}
+	}
+
+	bool tryWithdrawRetry() {
+		std::int64_t balance = m_balance.load(std::memory_order_relaxed);
+		do {
+			if (balance < Scale) {
+				return false;
+			}
+		} while (!m_balance.compare_exchange_weak(balance, balance - Scale, std::memory_order_relaxed));
+
+		return true;
+	}
+
+private:
+	// Fixed point, 1000 units per retry
+	static constexpr std::int64_t Scale = 1000;
+
+	const std::int64_t m_depositPerRequest;
+	const std::int64_t m_maxBalance;
+	std::atomic<std::int64_t> m_balance;
+};
+
+// Runs an operation on the timers worker until it succeeds, the attempts run out or the target's
+// budget is spent. All attempts go through the same TimerSlot, so retrying doesn't allocate.
+class RetryScheduler {
+public:
+	// Gets the 1-based attempt number, returns true on success
+	using Attempt = std::function<bool(unsigned)>;
+	using Finished = std::function<void(bool succeeded, unsigned attempts)>;
+
+	RetryScheduler(TimersManager &manager, RetryPolicy policy, RetryBudget &budget, Attempt attempt, Finished finished)
+		: m_policy(policy)
+		, m_budget(budget)
+		, m_attempt(std::move(attempt))
+		, m_finished(std::move(finished))
+		, m_rng(std::random_device{}())
+		, m_slot(manager, [this] { onTimer(); }) {
+
+	}
+
+	// The first attempt runs right away on the worker
+	void start() {
+		m_attempts = 0;
+		m_previousDelay = m_policy.baseDelay;
+		m_budget.onRequest();
+		m_slot.arm(0ms);
+	}
+
+	void stop() {
+		m_slot.disarm();
+	}
+
+private:
+	void onTimer() {
+		++m_attempts;
+
+		if (m_attempt(m_attempts)) {
+			m_finished(true, m_attempts);
+			return;
+		}
+
+		if (m_attempts >= m_policy.maxAttempts || !m_budget.tryWithdrawRetry()) {
+			m_finished(false, m_attempts);
+			return;
+		}
+
+		m_slot.arm(nextDelay());
+	}
+
+	std::chrono::milliseconds nextDelay() {
+		using Rep = std::chrono::milliseconds::rep;
+
+		const Rep base = m_policy.baseDelay.count();
+		const Rep cap = m_policy.maxDelay.count();
+		Rep delay = 0;
+
+		if (m_policy.backoff == RetryPolicy::Backoff::ExponentialJitter) {
+			const unsigned shift = std::min(m_attempts - 1, 30u);
+			const Rep ceiling = std::min(cap, base << shift);
+			delay = std::uniform_int_distribution<Rep>{ 0, ceiling }(m_rng);
+		}
+		else {
+			const Rep ceiling = std::max(base, m_previousDelay.count() * 3);
+			delay = std::min(cap, std::uniform_int_distribution<Rep>{ base, ceiling }(m_rng));
+		}
+
+		m_previousDelay = std::chrono::milliseconds{ delay };
+		return m_previousDelay;
+	}
+
+private:
+	const RetryPolicy m_policy;
+	RetryBudget &m_budget;
+	Attempt m_attempt;
+	Finished m_finished;
+	std::minstd_rand m_rng;
+	unsigned m_attempts{ 0 };
+	std::chrono::milliseconds m_previousDelay{ 0 };
+
+	// Last, so it's destroyed (and any running attempt finished) before the rest
+	TimersManager::TimerSlot m_slot;
+};
+
+// Runs the callback once events stop arriving for `delay`. An event only stores its time, the slot
+// is armed once per quiet period and pushed back lazily when it fires too early.
+class Debouncer {
+public:
+	template <typename Delay>
+	Debouncer(TimersManager &manager, Delay delay, TimersManager::TimerCallback callback)
+		: m_delay(std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay))
+		, m_callback(std::move(callback))
+		, m_slot(manager, [this] { onTimer(); }) {
+
+	}
+
+	void trigger() {
+		const auto now = std::chrono::steady_clock::now();
+		m_lastEvent.store(now.time_since_epoch().count(), std::memory_order_release);
+
+		if (!m_armed.exchange(true, std::memory_order_acq_rel)) {
+			m_slot.armAt(now + m_delay);
+		}
+	}
+
+	void cancel() {
+		m_slot.disarm();
+		m_armed.store(false, std::memory_order_release);
+	}
+
+private:
+	void onTimer() {
+		m_armed.store(false, std::memory_order_release);
+
+		const std::chrono::steady_clock::time_point deadline{ std::chrono::steady_clock::duration{ m_lastEvent.load(std::memory_order_acquire) } + m_delay };
+		if (deadline > std::chrono::steady_clock::now()) {
+			// More events came in, wait for the rest of the quiet period
+			if (!m_armed.exchange(true, std::memory_order_acq_rel)) {
+				m_slot.armAt(deadline);
+			}
+			return;
+		}
+
+		m_callback();
+	}
+
+private:
+	const std::chrono::steady_clock::duration m_delay;
+	TimersManager::TimerCallback m_callback;
+	std::atomic<std::chrono::steady_clock::rep> m_lastEvent{ 0 };
+	std::atomic<bool> m_armed{ false };
+	TimersManager::TimerSlot m_slot;
+};
+
+// Runs the callback at most once per `interval`, events in between are folded into the next run
+class Throttler {
+public:
+	template <typename Interval>
+	Throttler(TimersManager &manager, Interval interval, TimersManager::TimerCallback callback)
+		: m_interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval))
+		, m_callback(std::move(callback))
+		, m_slot(manager, [this] { onTimer(); }) {
+
+	}
+
+	void trigger() {
+		if (m_armed.exchange(true, std::memory_order_acq_rel)) {
+			return;
+		}
+
+		const std::chrono::steady_clock::time_point nextAllowed{ std::chrono::steady_clock::duration{ m_lastRun.load(std::memory_order_acquire) } + m_interval };
+		m_slot.armAt(std::max(std::chrono::steady_clock::now(), nextAllowed));
+	}
+
+	void cancel() {
+		m_slot.disarm();
+		m_armed.store(false, std::memory_order_release);
+	}
+
+private:
+	void onTimer() {
+		m_lastRun.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+
+		// Events from now on schedule the next run
+		m_armed.store(false, std::memory_order_release);
+		m_callback();
+	}
+
+private:
+	const std::chrono::steady_clock::duration m_interval;
+	TimersManager::TimerCallback m_callback;
+	std::atomic<std::chrono::steady_clock::rep> m_lastRun{ std::numeric_limits<std::chrono::steady_clock::rep>::min() / 2 };
+	std::atomic<bool> m_armed{ false };
+	TimersManager::TimerSlot m_slot;
+};
+
+// Classic 5 field cron expression: minute hour day-of-month month day-of-week, each field made
+// of comma separated `*`, `a` or `a-b` items with an optional `/step`. Evaluated in local time:
+// a fixed time that doesn't exist on a DST change day is skipped, one that happens twice runs once.
+class CronSchedule {
+public:
+	static CronSchedule parse(std::string_view expression) {
+		std::array<std::string_view, 5> fields;
+		std::size_t count = 0;
+
+		while (!expression.empty()) {
+			const std::size_t start = expression.find_first_not_of(' ');
+			if (start == std::string_view::npos) {
+				break;
+			}
+			expression.remove_prefix(start);
+
+			const std::size_t end = std::min(expression.find(' '), expression.size());
+			if (count == fields.size()) {
+				throw std::invalid_argument("cron expression has more than 5 fields");
+			}
+			fields[count++] = expression.substr(0, end);
+			expression.remove_prefix(end);
+		}
+
+		if (count != fields.size()) {
+			throw std::invalid_argument("cron expression needs 5 fields");
+		}
+
+		CronSchedule schedule;
+		schedule.m_minutes = parseField(fields[0], 0, 59);
+		schedule.m_hours = parseField(fields[1], 0, 23);
+		schedule.m_daysOfMonth = parseField(fields[2], 1, 31);
+		schedule.m_months = parseField(fields[3], 1, 12);
+		schedule.m_daysOfWeek = parseField(fields[4], 0, 7);
+
+		// 7 is Sunday too
+		if (schedule.m_daysOfWeek & (1ull << 7)) {
+			schedule.m_daysOfWeek = (schedule.m_daysOfWeek | 1) & ~(1ull << 7);
+		}
+
+		schedule.m_anyDayOfMonth = fields[2] == "*";
+		schedule.m_anyDayOfWeek = fields[4] == "*";
+		schedule.m_fixedHours = fields[1].find('*') == std::string_view::npos;
+		return schedule;
+	}
+
+	// First occurrence strictly after `after`, time_point::max() if there is none. Walks the fields
+	// from the month down, skipping whole months, days and hours that can't match. Hours and
+	// minutes are stepped in absolute time so both passes of a repeated hour are visited.
+	std::chrono::system_clock::time_point next(std::chrono::system_clock::time_point after) const {
+		const std::time_t afterSeconds = std::chrono::system_clock::to_time_t(after);
+		const std::tm afterLocal = toLocal(afterSeconds);
+
+		std::time_t current = afterSeconds - afterLocal.tm_sec + 60;
+		std::tm local = toLocal(current);
+
+		// Enough for "every leap day", anything slower is treated as never
+		for (int step = 0; step < 100'000; ++step) {
+			if (!(m_months & (1ull << (local.tm_mon + 1)))) {
+				local.tm_mon += 1;
+				local.tm_mday = 1;
+				local.tm_hour = 0;
+				local.tm_min = 0;
+				current = fromLocal(local);
+			}
+			else if (!dayMatches(local)) {
+				local.tm_mday += 1;
+				local.tm_hour = 0;
+				local.tm_min = 0;
+				current = fromLocal(local);
+			}
+			else if (!(m_hours & (1ull << local.tm_hour))) {
+				current += (60 - local.tm_min) * 60;
+			}
+			else if (!(m_minutes & (1ull << local.tm_min))) {
+				current += 60;
+			}
+			else if (m_fixedHours && !laterLocalTime(local, afterLocal)) {
+				// Second pass of the hour repeated when DST ends, a fixed time job already ran in it
+				current += 60;
+			}
+			else {
+				return std::chrono::system_clock::from_time_t(current);
+			}
+
+			local = toLocal(current);
+		}
+
+		return std::chrono::system_clock::time_point::max();
+	}
+
+private:
+	static std::uint64_t parseNumber(std::string_view text, unsigned min, unsigned max) {
+		if (text.empty() || text.find_first_not_of("0123456789") != std::string_view::npos) {
+			throw std::invalid_argument("bad number in cron expression");
+		}
+
+		std::uint64_t value = 0;
+		for (const char c : text) {
+			value = value * 10 + static_cast<std::uint64_t>(c - '0');
+			if (value > max) {
+				break;
+			}
+		}
+
+		if (value < min || value > max) {
+			throw std::invalid_argument("value out of range in cron expression");
+		}
+		return value;
+	}
+
+	static std::uint64_t parseField(std::string_view field, unsigned min, unsigned max) {
+		std::uint64_t bits = 0;
+
+		while (true) {
+			const std::size_t comma = std::min(field.find(','), field.size());
+			std::string_view item = field.substr(0, comma);
+
+			std::uint64_t step = 1;
+			if (const std::size_t slash = item.find('/'); slash != std::string_view::npos) {
+				step = parseNumber(item.substr(slash + 1), 1, max);
+				item = item.substr(0, slash);
+			}
+
+			std::uint64_t first = min;
+			std::uint64_t last = max;
+			if (item != "*") {
+				const std::size_t dash = item.find('-');
+				first = parseNumber(item.substr(0, dash), min, max);
+				last = dash == std::string_view::npos ? (step > 1 ? max : first) : parseNumber(item.substr(dash + 1), min, max);
+				if (first > last) {
+					throw std::invalid_argument("empty range in cron expression");
+				}
+			}
+
+			for (std::uint64_t value = first; value <= last; value += step) {
+				bits |= 1ull << value;
+			}
+
+			if (comma == field.size()) {
+				return bits;
+			}
+			field.remove_prefix(comma + 1);
+		}
+	}
+
+	static std::tm toLocal(std::time_t seconds) {
+		std::tm local{};
+#if defined(_MSC_VER)
+		localtime_s(&local, &seconds);
+#else
+		localtime_r(&seconds, &local);
+#endif
+		return local;
+	}
+
+	// Carries overflowing fields over and lets mktime pick the DST state
+	static std::time_t fromLocal(std::tm local) {
+		local.tm_isdst = -1;
+		return std::mktime(&local);
+	}
+
+	static bool laterLocalTime(const std::tm &lhs, const std::tm &rhs) {
+		return std::tie(lhs.tm_year, lhs.tm_mon, lhs.tm_mday, lhs.tm_hour, lhs.tm_min) > std::tie(rhs.tm_year, rhs.tm_mon, rhs.tm_mday, rhs.tm_hour, rhs.tm_min);
+	}
+
+	// Like cron, when both day fields are restricted either of them is enough
+	bool dayMatches(const std::tm &local) const {
+		const bool dayOfMonth = (m_daysOfMonth & (1ull << local.tm_mday)) != 0;
+		const bool dayOfWeek = (m_daysOfWeek & (1ull << local.tm_wday)) != 0;
+
+		if (!m_anyDayOfMonth && !m_anyDayOfWeek) {
+			return dayOfMonth || dayOfWeek;
+		}
+		return dayOfMonth && dayOfWeek;
+	}
+
+private:
+	std::uint64_t m_minutes{ 0 };
+	std::uint64_t m_hours{ 0 };
+	std::uint64_t m_daysOfMonth{ 0 };
+	std::uint64_t m_months{ 0 };
+	std::uint64_t m_daysOfWeek{ 0 };
+	bool m_anyDayOfMonth{ true };
+	bool m_anyDayOfWeek{ true };
+	bool m_fixedHours{ false };
+};
+
+// Runs the callback at every occurrence of a cron schedule. Each occurrence is computed from the
+// previous one and armed as a wall clock deadline, so clock steps and DST don't make it drift.
+class CronJob {
+public:
+	CronJob(TimersManager &manager, CronSchedule schedule, TimersManager::TimerCallback callback)
+		: m_schedule(schedule)
+		, m_callback(std::move(callback))
+		, m_slot(manager, [this] { onTimer(); }) {
+		armNext(std::chrono::system_clock::now());
+	}
+
+	std::chrono::system_clock::time_point nextOccurrence() const {
+		return m_next.load(std::memory_order_acquire);
+	}
+
+private:
+	void onTimer() {
+		const auto occurrence = m_next.load(std::memory_order_relaxed);
+		m_callback();
+
+		// After a jump forward the missed occurrences are skipped instead of run back to back
+		armNext(std::max(occurrence, std::chrono::system_clock::now()));
+	}
+
+	void armNext(std::chrono::system_clock::time_point after) {
+		const auto next = m_schedule.next(after);
+		m_next.store(next, std::memory_order_release);
+
+		if (next != std::chrono::system_clock::time_point::max()) {
+			m_slot.armAtWallClock(next);
+		}
+	}
+
+private:
+	const CronSchedule m_schedule;
+	TimersManager::TimerCallback m_callback;
+	std::atomic<std::chrono::system_clock::time_point> m_next{};
+	TimersManager::TimerSlot m_slot;
+};
+
+// Token buckets per key, refilled from the elapsed time whenever they are touched. Only buckets
+// with queued waiters have a timer, so the heap holds one entry per blocked key, not per key.
+template <typename Key, typename Hash = std::hash<Key>>
+class RateLimiter {
+public:
+	RateLimiter(TimersManager &manager, double tokensPerSecond, double burst)
+		: m_manager(manager)
+		, m_tokensPerSecond(tokensPerSecond)
+		, m_burst(burst) {
+
+	}
+
+	RateLimiter(const RateLimiter &) = delete;
+	RateLimiter &operator=(const RateLimiter &) = delete;
+
+	~RateLimiter() {
+		std::unique_lock lock(m_mtx);
+		m_closing = true;
+
+		for (auto &[key, bucket] : m_buckets) {
+			if (bucket.timerArmed && bucket.timer->disarm()) {
+				bucket.timerArmed = false;
+				--m_armedTimers;
+			}
+		}
+
+		// The rest are running right now
+		m_idleCv.wait(lock, [this] { return m_armedTimers == 0; });
+	}
+
+	// Never waits, fails while other callers are queued on the key
+	bool tryAcquire(const Key &key, double tokens = 1.0) {
+		std::lock_guard lock(m_mtx);
+
+		Bucket &bucket = bucketFor(key);
+		refill(bucket, std::chrono::steady_clock::now());
+
+		if (!bucket.waiters.empty() || bucket.tokens < tokens) {
+			return false;
+		}
+
+		bucket.tokens -= tokens;
+		return true;
+	}
+
+	// Runs `onAcquired` inline if the tokens are there, otherwise on the timers worker once they are.
+	// More tokens than the burst can never be there, such a request throws instead of blocking the key.
+	void acquire(const Key &key, TimersManager::TimerCallback onAcquired, double tokens = 1.0) {
+		if (tokens > m_burst) {
+			throw std::invalid_argument("rate limiter request exceeds the burst size");
+		}
+
+		{
+			std::lock_guard lock(m_mtx);
+
+			Bucket &bucket = bucketFor(key);
+			refill(bucket, std::chrono::steady_clock::now());
+
+			if (!bucket.waiters.empty() || bucket.tokens < tokens) {
+				bucket.waiters.push_back(Waiter{ tokens, std::move(onAcquired) });
+				if (!bucket.timerArmed) {
+					armRefill(bucket);
+				}
+				return;
+			}
+
+			bucket.tokens -= tokens;
+		}
+
+		onAcquired();
+	}
+
+	std::size_t armedTimers() const {
+		std::lock_guard lock(m_mtx);
+		return m_armedTimers;
+	}
+
+private:
+	struct Waiter {
+		double tokens;
+		TimersManager::TimerCallback callback;
+	};
+
+	struct Bucket {
+		double tokens{ 0.0 };
+		std::chrono::steady_clock::time_point lastRefill{};
+		std::deque<Waiter> waiters;
+		// A slot rather than an inserted timer, so admission control never turns the refill away and
+		// strands the waiters
+		std::unique_ptr<TimersManager::TimerSlot> timer;
+		bool timerArmed{ false };
+	};
+
+	Bucket &bucketFor(const Key &key) {
+		auto [it, inserted] = m_buckets.try_emplace(key);
+		if (inserted) {
+			it->second.tokens = m_burst;
+			it->second.lastRefill = std::chrono::steady_clock::now();
+		}
+		return it->second;
+	}
+
+	void refill(Bucket &bucket, std::chrono::steady_clock::time_point now) {
+		const double elapsed = std::chrono::duration<double>(now - bucket.lastRefill).count();
+		bucket.tokens = std::min(m_burst, bucket.tokens + elapsed * m_tokensPerSecond);
+		bucket.lastRefill = now;
+	}
+
+	// Wakes up when the first waiter can be served
+	void armRefill(Bucket &bucket) {
+		const double missing = std::max(0.0, bucket.waiters.front().tokens - bucket.tokens);
+		const auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(missing / m_tokensPerSecond));
+
+		if (!bucket.timer) {
+			bucket.timer = std::make_unique<TimersManager::TimerSlot>(m_manager, [this, &bucket] { onRefill(bucket); });
+		}
+		bucket.timer->arm(delay);
+		bucket.timerArmed = true;
+		++m_armedTimers;
+	}
+
+	void onRefill(Bucket &bucket) {
+		std::vector<TimersManager::TimerCallback> ready;
+
+		{
+			std::lock_guard lock(m_mtx);
+
+			bucket.timerArmed = false;
+			--m_armedTimers;
+
+			refill(bucket, std::chrono::steady_clock::now());
+			while (!bucket.waiters.empty() && bucket.waiters.front().tokens <= bucket.tokens) {
+				bucket.tokens -= bucket.waiters.front().tokens;
+				ready.push_back(std::move(bucket.waiters.front().callback));
+				bucket.waiters.pop_front();
+			}
+
+			if (m_closing) {
+				m_idleCv.notify_all();
+			}
+			else if (!bucket.waiters.empty()) {
+				armRefill(bucket);
+			}
+		}
+
+		for (auto &callback : ready) {
+			callback();
+		}
+	}
+
+private:
+	TimersManager &m_manager;
+	const double m_tokensPerSecond;
+	const double m_burst;
+
+	mutable std::mutex m_mtx;
+	std::condition_variable m_idleCv;
+	std::unordered_map<Key, Bucket, Hash> m_buckets;
+	std::size_t m_armedTimers{ 0 };
+	bool m_closing{ false };
+};
+
+#if defined(TIMERS_HAS_LINUX)
+namespace shm_detail {
+	constexpr std::uint32_t Magic = 0x48534D54; // "TMSH"
+	constexpr std::uint32_t MaxClients = 64;
+	// Fired cookies waiting for a client to pick them up
+	constexpr std::uint32_t RingSize = 4096;
+
+	struct Entry {
+		// CLOCK_MONOTONIC nanoseconds, the same for every process on the host
+		std::int64_t deadline;
+		std::uint64_t cookie;
+		std::uint32_t client;
+		// Generation of the slot when inserted, entries of an earlier owner are dropped
+		std::uint32_t generation;
+
+		bool operator>(const Entry &rhs) const {
+			return deadline > rhs.deadline;
+		}
+	};
+
+	struct Client {
+		// 0 while the slot is free
+		std::int32_t pid;
+		// Bumped every time the slot is claimed, cookies restart at 1 in every process
+		std::uint32_t generation;
+		// Written by the service and the client respectively
+		std::atomic<std::uint64_t> head;
+		std::atomic<std::uint64_t> tail;
+		std::uint64_t ring[RingSize];
+	};
+
+	// Followed by `capacity` heap entries
+	struct Segment {
+		std::uint32_t magic;
+		std::uint32_t capacity;
+		std::uint32_t size;
+		std::uint32_t stopping;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		Client clients[MaxClients];
+
+		Entry *heap() {
+			return reinterpret_cast<Entry *>(this + 1);
+		}
+	};
+
+	inline std::size_t segmentSize(std::uint32_t capacity) {
+		return sizeof(Segment) + std::size_t{ capacity } * sizeof(Entry);
+	}
+
+	// The mutex is robust: if a process died holding it the heap order may be broken, so it is rebuilt.
+	// Condition waits reacquire the mutex and report a dead owner the same way.
+	inline void recoverLock(Segment &segment, int rc) {
+		if (rc == EOWNERDEAD) {
+			std::make_heap(segment.heap(), segment.heap() + segment.size, std::greater{});
+			pthread_mutex_consistent(&segment.mutex);
+		}
+		else if (rc != 0 && rc != ETIMEDOUT) {
+			throw std::system_error(rc, std::generic_category(), "lock timers segment");
+		}
+	}
+
+	inline void lock(Segment &segment) {
+		recoverLock(segment, pthread_mutex_lock(&segment.mutex));
+	}
+
+	inline void wait(Segment &segment) {
+		recoverLock(segment, pthread_cond_wait(&segment.cond, &segment.mutex));
+	}
+
+	inline void waitUntil(Segment &segment, const timespec &until) {
+		recoverLock(segment, pthread_cond_timedwait(&segment.cond, &segment.mutex, &until));
+	}
+
+	inline void unlock(Segment &segment) {
+		pthread_mutex_unlock(&segment.mutex);
+	}
+
+	// Removes heap[index] from the heap kept with std::greater, the last entry takes its place
+	inline void eraseAt(Entry *heap, std::uint32_t &size, std::uint32_t index) {
+		--size;
+		if (index == size) {
+			return;
+		}
+
+		heap[index] = heap[size];
+
+		// Earlier than its new parent moves it up, otherwise it may have to go down
+		if (index > 0 && heap[(index - 1) / 2] > heap[index]) {
+			do {
+				std::swap(heap[index], heap[(index - 1) / 2]);
+				index = (index - 1) / 2;
+			} while (index > 0 && heap[(index - 1) / 2] > heap[index]);
+			return;
+		}
+
+		for (;;) {
+			const std::uint32_t left = 2 * index + 1;
+			if (left >= size) {
+				return;
+			}
+
+			const std::uint32_t child = left + 1 < size && heap[left] > heap[left + 1] ? left + 1 : left;
+			if (!(heap[index] > heap[child])) {
+				return;
+			}
+
+			std::swap(heap[index], heap[child]);
+			index = child;
+		}
+	}
+
+	inline std::int64_t monotonicNow() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Clients hand their eventfd to the service over this socket
+	inline sockaddr_un registrationAddress(const std::string &name, socklen_t &length) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+
+		// Abstract namespace, nothing to clean up on disk
+		const std::string path = "timers" + name;
+		const std::size_t copied = std::min(path.size(), sizeof(address.sun_path) - 2);
+		std::memcpy(address.sun_path + 1, path.data(), copied);
+		length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + copied);
+		return address;
+	}
+
+	struct Mapping {
+		Mapping(int fd, std::size_t size) : size(size) {
+			void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (data == MAP_FAILED) {
+				throw std::system_error(errno, std::generic_category(), "mmap timers segment");
+			}
+			segment = static_cast<Segment *>(data);
+		}
+
+		Mapping(const Mapping &) = delete;
+		Mapping &operator=(const Mapping &) = delete;
+
+		~Mapping() {
+			::munmap(segment, size);
+		}
+
+		Segment *segment;
+		std::size_t size;
+	};
+}
+
+// Host wide timing thread. The heap lives in a POSIX shared memory segment under a robust,
+// process-shared mutex; clients in other processes insert into it and get woken up through
+// their own eventfd when their timers fire.
+class SharedTimerService {
+public:
+	explicit SharedTimerService(std::string name, std::uint32_t capacity = 65'536)
+		: m_name(std::move(name)) {
+		const int fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "shm_open " + m_name);
+		}
+
+		if (::ftruncate(fd, static_cast<off_t>(shm_detail::segmentSize(capacity))) != 0) {
+			const int error = errno;
+			::close(fd);
+			::shm_unlink(m_name.c_str());
+			throw std::system_error(error, std::generic_category(), "ftruncate " + m_name);
+		}
+
+		m_mapping.emplace(fd, shm_detail::segmentSize(capacity));
+		::close(fd);
+
+		shm_detail::Segment &segment = *m_mapping->segment;
+		segment.capacity = capacity;
+
+		pthread_mutexattr_t mutexAttr;
+		pthread_mutexattr_init(&mutexAttr);
+		pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+		pthread_mutex_init(&segment.mutex, &mutexAttr);
+		pthread_mutexattr_destroy(&mutexAttr);
+
+		pthread_condattr_t condAttr;
+		pthread_condattr_init(&condAttr);
+		pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+		pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+		pthread_cond_init(&segment.cond, &condAttr);
+		pthread_condattr_destroy(&condAttr);
+
+		m_clientFds.fill(-1);
+		listen();
+
+		// Clients check the magic, so it goes last
+		std::atomic_thread_fence(std::memory_order_release);
+		segment.magic = shm_detail::Magic;
+
+		m_registrar = std::jthread([this] {
+			registrarLoop();
+		});
+		m_timer = std::jthread([this] {
+			timerLoop();
+		});
+	}
+
+	SharedTimerService(const SharedTimerService &) = delete;
+	SharedTimerService &operator=(const SharedTimerService &) = delete;
+
+	~SharedTimerService() {
+		shm_detail::Segment &segment = *m_mapping->segment;
+
+		shm_detail::lock(segment);
+		segment.stopping = 1;
+		pthread_cond_broadcast(&segment.cond);
+		shm_detail::unlock(segment);
+		m_timer.join();
+
+		::shutdown(m_listenFd, SHUT_RDWR);
+		m_registrar.join();
+		::close(m_listenFd);
+
+		for (const int fd : m_clientFds) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+
+		::shm_unlink(m_name.c_str());
+	}
 
 private:
-	using TimeoutType = std::chrono::steady_clock::time_point;
+	void listen() {
+		m_listenFd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
 
-	template <typename TimeoutType>
-	static constexpr bool IsTimeoutDuration = std::is_same_v<TimeoutType, std::chrono::duration<typename TimeoutType::rep, typename TimeoutType::period>>;
+		socklen_t length = 0;
+		const sockaddr_un address = shm_detail::registrationAddress(m_name, length);
+		if (m_listenFd < 0 || ::bind(m_listenFd, reinterpret_cast<const sockaddr *>(&address), length) != 0 || ::listen(m_listenFd, 16) != 0) {
+			throw std::system_error(errno, std::generic_category(), "listen for timer clients");
+		}
+	}
 
-	struct Timer {
-		TimeoutType timeout{};
-		TimerCallback callback{};
+	// Each registration is one message: the client slot in the data and its eventfd as SCM_RIGHTS
+	void registrarLoop() {
+		while (true) {
+			const int connection = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (connection < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return;
+			}
+
+			std::uint32_t slot = 0;
+			alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+			iovec data{ &slot, sizeof(slot) };
+			msghdr message{};
+			message.msg_iov = &data;
+			message.msg_iovlen = 1;
+			message.msg_control = control;
+			message.msg_controllen = sizeof(control);
+
+			const cmsghdr *header = ::recvmsg(connection, &message, 0) == sizeof(slot) ? CMSG_FIRSTHDR(&message) : nullptr;
+			if (header && header->cmsg_type == SCM_RIGHTS && slot < shm_detail::MaxClients) {
+				int eventFd = -1;
+				std::memcpy(&eventFd, CMSG_DATA(header), sizeof(eventFd));
 
-		bool operator>(const Timer &rhs) const {
-			return timeout > rhs.timeout;
+				std::lock_guard lock(m_clientFdsMtx);
+				if (m_clientFds[slot] >= 0) {
+					::close(m_clientFds[slot]);
+				}
+				m_clientFds[slot] = eventFd;
+			}
+
+			// The acknowledgement tells the client its timers can be delivered from now on
+			const char ack = 1;
+			::send(connection, &ack, sizeof(ack), MSG_NOSIGNAL);
+			::close(connection);
 		}
-	};
+	}
 
-	static TimeoutType timeNow() {
-		return std::chrono::steady_clock::now();
+	void timerLoop() {
+		shm_detail::Segment &segment = *m_mapping->segment;
+		shm_detail::Entry *heap = segment.heap();
+		std::array<bool, shm_detail::MaxClients> wake{};
+
+		shm_detail::lock(segment);
+
+		while (!segment.stopping) {
+			if (segment.size == 0) {
+				shm_detail::wait(segment);
+				continue;
+			}
+
+			const std::int64_t now = shm_detail::monotonicNow();
+			if (heap[0].deadline > now) {
+				const timespec until{ static_cast<time_t>(heap[0].deadline / 1'000'000'000), static_cast<long>(heap[0].deadline % 1'000'000'000) };
+				shm_detail::waitUntil(segment, until);
+				continue;
+			}
+
+			while (segment.size > 0 && heap[0].deadline <= now) {
+				const shm_detail::Entry entry = heap[0];
+				std::pop_heap(heap, heap + segment.size, std::greater{});
+				--segment.size;
+
+				shm_detail::Client &client = segment.clients[entry.client];
+				if (client.pid == 0 || client.generation != entry.generation) {
+					continue;
+				}
+
+				const std::uint64_t head = client.head.load(std::memory_order_relaxed);
+				if (head - client.tail.load(std::memory_order_acquire) == shm_detail::RingSize) {
+					// The client is behind, try again a bit later instead of losing the timer
+					heap[segment.size++] = shm_detail::Entry{ now + 1'000'000, entry.cookie, entry.client, entry.generation };
+					std::push_heap(heap, heap + segment.size, std::greater{});
+					break;
+				}
+
+				client.ring[head % shm_detail::RingSize] = entry.cookie;
+				client.head.store(head + 1, std::memory_order_release);
+				wake[entry.client] = true;
+			}
+
+			shm_detail::unlock(segment);
+
+			{
+				std::lock_guard lock(m_clientFdsMtx);
+				for (std::uint32_t i = 0; i < shm_detail::MaxClients; ++i) {
+					if (std::exchange(wake[i], false) && m_clientFds[i] >= 0) {
+						const std::uint64_t one = 1;
+						[[maybe_unused]] const ssize_t written = ::write(m_clientFds[i], &one, sizeof(one));
+					}
+				}
+			}
+
+			shm_detail::lock(segment);
+		}
+
+		shm_detail::unlock(segment);
 	}
 
+private:
+	const std::string m_name;
+	std::optional<shm_detail::Mapping> m_mapping;
+	int m_listenFd{ -1 };
+
+	std::mutex m_clientFdsMtx;
+	std::array<int, shm_detail::MaxClients> m_clientFds;
+
+	std::jthread m_registrar;
+	std::jthread m_timer;
+};
+
+// A process's handle on a SharedTimerService. Callbacks stay in this process, only a cookie goes
+// to the shared heap; a local thread sleeps on the eventfd and runs whatever fired.
+class SharedTimerClient {
 public:
-	TimersManager() {
-		m_worker = std::jthread([this](std::stop_token stopToken) {
-			workerLoop(stopToken);
+	using Cookie = std::uint64_t;
+
+	explicit SharedTimerClient(const std::string &name) {
+		const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+		}
+
+		struct stat info {};
+		::fstat(fd, &info);
+		m_mapping.emplace(fd, static_cast<std::size_t>(info.st_size));
+		::close(fd);
+
+		shm_detail::Segment &segment = *m_mapping->segment;
+		if (segment.magic != shm_detail::Magic) {
+			throw std::runtime_error("not a timers segment: " + name);
+		}
+
+		claimSlot();
+
+		m_eventFd = ::eventfd(0, EFD_CLOEXEC);
+		if (m_eventFd < 0) {
+			throw std::system_error(errno, std::generic_category(), "eventfd");
+		}
+		registerEventFd(name);
+
+		m_dispatcher = std::jthread([this] {
+			dispatchLoop();
 		});
 	}
 
-	TimersManager(const TimersManager &) = delete;
-	TimersManager &operator = (const TimersManager &) = delete;
-	TimersManager(TimersManager &&) = delete;
-	TimersManager &operator=(TimersManager &&) = delete;
+	SharedTimerClient(const SharedTimerClient &) = delete;
+	SharedTimerClient &operator=(const SharedTimerClient &) = delete;
 
-	~TimersManager() {
-		// Make sure the worker is stopped before clearing any memory
-		if (m_worker.joinable()) {
-			m_worker.request_stop();
-			m_cv.notify_one();
-			m_worker.join();
-		}
+	~SharedTimerClient() {
+		m_stopping.store(true, std::memory_order_release);
+		const std::uint64_t one = 1;
+		[[maybe_unused]] const ssize_t written = ::write(m_eventFd, &one, sizeof(one));
+		m_dispatcher.join();
+
+		// Timers still in the heap are dropped by the service, the slot's next owner gets a new generation
+		shm_detail::Segment &segment = *m_mapping->segment;
+		shm_detail::lock(segment);
+		segment.clients[m_slot].pid = 0;
+		shm_detail::unlock(segment);
+
+		::close(m_eventFd);
 	}
 
 	template <typename Timeout>
-	requires IsTimeoutDuration<Timeout>
-	void insertTimer(TimerCallback cb, Timeout timeout) {
-		const bool wakeUpWorker = std::invoke([&] {
+	Cookie insertTimer(TimersManager::TimerCallback cb, Timeout timeout) {
+		const std::int64_t deadline = shm_detail::monotonicNow() + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+
+		Cookie cookie = 0;
+		{
+			std::lock_guard lock(m_mtx);
+			cookie = ++m_lastCookie;
+			m_callbacks.emplace(cookie, std::move(cb));
+		}
+
+		shm_detail::Segment &segment = *m_mapping->segment;
+		shm_detail::Entry *heap = segment.heap();
+
+		shm_detail::lock(segment);
+		if (segment.size == segment.capacity) {
+			shm_detail::unlock(segment);
+
 			std::lock_guard lock(m_mtx);
+			m_callbacks.erase(cookie);
+			throw std::length_error("shared timers segment is full");
+		}
+
+		const bool newHead = segment.size == 0 || deadline < heap[0].deadline;
+		heap[segment.size++] = shm_detail::Entry{ deadline, cookie, m_slot, m_generation };
+		std::push_heap(heap, heap + segment.size, std::greater{});
 
-			const TimeoutType internalTimeout = timeNow() + std::chrono::duration_cast<typename TimeoutType::duration>(timeout);
-			const TimeoutType previousNearestTimeout = m_timers.empty() ? TimeoutType::max() : m_timers.front().timeout;
+		if (newHead) {
+			pthread_cond_signal(&segment.cond);
+		}
+		shm_detail::unlock(segment);
 
-			// Add new timer and heapify
-			m_timers.push_back(Timer{ internalTimeout, std::move(cb) });
-			std::push_heap(m_timers.begin(), m_timers.end(), std::greater{});
+		return cookie;
+	}
 
-			// This timer is on the top, wake up the worker
-			if (internalTimeout < previousNearestTimeout) {
-				m_shouldProcessTimers = true;
+	// The shared entry leaves the heap too, timeouts that mostly get cancelled would fill it
+	// otherwise. Finding it is a scan of the heap under the segment mutex.
+	bool cancelTimer(Cookie cookie) {
+		{
+			std::lock_guard lock(m_mtx);
+			if (m_callbacks.erase(cookie) == 0) {
+				return false;
 			}
+		}
 
-			return m_shouldProcessTimers;
-		});
+		shm_detail::Segment &segment = *m_mapping->segment;
+		shm_detail::Entry *heap = segment.heap();
 
-		if (wakeUpWorker) {
-			m_cv.notify_one();
+		// Not found when the service already delivered it, the dispatcher then finds no callback
+		shm_detail::lock(segment);
+		for (std::uint32_t i = 0; i < segment.size; ++i) {
+			if (heap[i].cookie == cookie && heap[i].client == m_slot && heap[i].generation == m_generation) {
+				shm_detail::eraseAt(heap, segment.size, i);
+				break;
+			}
 		}
+		shm_detail::unlock(segment);
+
+		return true;
+	}
+
+	// For integrating with an event loop instead of the dispatcher thread
+	int eventFd() const {
+		return m_eventFd;
 	}
 
 private:
-	void workerLoop(std::stop_token stopToken) {
-		std::cout << "TimersManager worker started\n";
+	void claimSlot() {
+		shm_detail::Segment &segment = *m_mapping->segment;
 
-		const auto waitPred = [this, stopToken] { return m_shouldProcessTimers || stopToken.stop_requested(); };
+		shm_detail::lock(segment);
+		for (std::uint32_t i = 0; i < shm_detail::MaxClients; ++i) {
+			shm_detail::Client &client = segment.clients[i];
 
-		while (true) {
-			TimerCallback cb;
+			// Slots of processes that died without releasing them are taken over
+			if (client.pid == 0 || (::kill(client.pid, 0) != 0 && errno == ESRCH)) {
+				client.pid = ::getpid();
+				m_generation = ++client.generation;
+				client.tail.store(client.head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				m_slot = i;
+				shm_detail::unlock(segment);
+				return;
+			}
+		}
+		shm_detail::unlock(segment);
 
-			{
-				std::unique_lock lock(m_mtx);
+		throw std::runtime_error("no free client slot in the timers segment");
+	}
 
-				if (!m_timers.empty()) {
-					const TimeoutType nearestTimeout = m_timers.front().timeout;
-					m_cv.wait_until(lock, nearestTimeout, waitPred);
-				}
-				else {
-					m_cv.wait(lock, waitPred);
-				}
+	void registerEventFd(const std::string &name) {
+		const int connection = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
 
-				// Check if we have to exit(note we don't process all pending timers)
-				if (stopToken.stop_requested()) {
-					break;
-				}
+		socklen_t length = 0;
+		const sockaddr_un address = shm_detail::registrationAddress(name, length);
+		if (connection < 0 || ::connect(connection, reinterpret_cast<const sockaddr *>(&address), length) != 0) {
+			const int error = errno;
+			if (connection >= 0) {
+				::close(connection);
+			}
+			throw std::system_error(error, std::generic_category(), "connect to timers service");
+		}
 
-				m_shouldProcessTimers = false;
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+		iovec data{ &m_slot, sizeof(m_slot) };
+		msghdr message{};
+		message.msg_iov = &data;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
 
-				if (m_timers.front().timeout <= timeNow()) {
-					cb = std::move(m_timers.front().callback);
+		cmsghdr *header = CMSG_FIRSTHDR(&message);
+		header->cmsg_level = SOL_SOCKET;
+		header->cmsg_type = SCM_RIGHTS;
+		header->cmsg_len = CMSG_LEN(sizeof(int));
+		std::memcpy(CMSG_DATA(header), &m_eventFd, sizeof(int));
 
-					// Reorder the vector and remove the popped element
-					std::pop_heap(m_timers.begin(), m_timers.end(), std::greater{});
-					m_timers.pop_back();
-				}
+		char ack = 0;
+		const bool registered = ::sendmsg(connection, &message, MSG_NOSIGNAL) == sizeof(m_slot) && ::recv(connection, &ack, sizeof(ack), 0) == sizeof(ack);
+		::close(connection);
+
+		if (!registered) {
+			throw std::runtime_error("timers service refused the registration");
+		}
+	}
+
+	void dispatchLoop() {
+		shm_detail::Client &client = m_mapping->segment->clients[m_slot];
+
+		while (true) {
+			std::uint64_t count = 0;
+			if (::read(m_eventFd, &count, sizeof(count)) < 0 && errno == EINTR) {
+				continue;
 			}
 
-			if (cb) {
-				cb();
+			if (m_stopping.load(std::memory_order_acquire)) {
+				return;
 			}
-		}
 
-		std::cout << "TimersManager worker exiting...\n";
+			const std::uint64_t head = client.head.load(std::memory_order_acquire);
+			for (std::uint64_t tail = client.tail.load(std::memory_order_relaxed); tail != head; ++tail) {
+				const Cookie cookie = client.ring[tail % shm_detail::RingSize];
+				client.tail.store(tail + 1, std::memory_order_release);
+
+				TimersManager::TimerCallback cb;
+				{
+					std::lock_guard lock(m_mtx);
+					if (const auto it = m_callbacks.find(cookie); it != m_callbacks.end()) {
+						cb = std::move(it->second);
+						m_callbacks.erase(it);
+					}
+				}
+
+				if (cb) {
+					cb();
+				}
+			}
+		}
 	}
 
 private:
+	std::optional<shm_detail::Mapping> m_mapping;
+	std::uint32_t m_slot{ 0 };
+	std::uint32_t m_generation{ 0 };
+	int m_eventFd{ -1 };
+
 	std::mutex m_mtx;
-	std::condition_variable m_cv;
-	bool m_shouldProcessTimers{ false };
-	std::vector<Timer> m_timers;
-	std::jthread m_worker;
+	Cookie m_lastCookie{ 0 };
+	std::unordered_map<Cookie, TimersManager::TimerCallback> m_callbacks;
+
+	std::atomic<bool> m_stopping{ false };
+	std::jthread m_dispatcher;
 };
+#endif
 
 // Test timer to measure the accuracy of the manager
 struct TestTimer {
@@ -166,8 +5079,320 @@ struct RepeatingTimer {
 	}
 };
 
-int main() {
-	TimersManager timers;
+// Pop throughput of the heap used by the worker against the std::push_heap/std::pop_heap binary heap it replaced
+void benchmarkHeapPop() {
+	constexpr std::size_t count = 1'000'000;
+
+	std::mt19937_64 rng{ 42 };
+	std::uniform_int_distribution<std::int64_t> dist{ 0, std::int64_t{ 1 } << 40 };
+	std::vector<std::int64_t> deadlines(count);
+	for (auto &deadline : deadlines) {
+		deadline = dist(rng);
+	}
+
+	const auto report = [](const char *name, auto elapsed, std::int64_t checksum) {
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		std::cout << name << ": " << static_cast<double>(count) / seconds / 1e6 << "M pops/s (checksum " << checksum << ")\n";
+	};
+
+	{
+		struct LegacyTimer {
+			std::int64_t timeout;
+			TimersManager::TimerCallback callback;
+
+			bool operator>(const LegacyTimer &rhs) const {
+				return timeout > rhs.timeout;
+			}
+		};
+
+		std::vector<LegacyTimer> timers;
+		timers.reserve(count);
+		for (const auto deadline : deadlines) {
+			timers.push_back(LegacyTimer{ deadline, TestTimer{} });
+			std::push_heap(timers.begin(), timers.end(), std::greater{});
+		}
+
+		std::int64_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while (!timers.empty()) {
+			checksum ^= timers.front().timeout;
+			std::pop_heap(timers.begin(), timers.end(), std::greater{});
+			timers.pop_back();
+		}
+		report("std::pop_heap", std::chrono::steady_clock::now() - start, checksum);
+	}
+
+	// std::function payloads like the heap it replaced, and pointers like the manager's nodes
+	std::vector<TestTimer> payloads(count);
+	const auto callbackPayload = [](TestTimer &) -> TimersManager::TimerCallback { return TestTimer{}; };
+	const auto pointerPayload = [](TestTimer &timer) { return &timer; };
+
+	const auto runTimerHeap = [&](const char *name, heap_detail::MinChildKernel kernel, auto makePayload) {
+		TimerHeap<decltype(makePayload(payloads[0]))> heap{ kernel };
+		heap.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			heap.push(deadlines[i], makePayload(payloads[i]));
+		}
+
+		std::int64_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while (!heap.empty()) {
+			checksum ^= heap.topDeadline();
+			heap.pop();
+		}
+		report(name, std::chrono::steady_clock::now() - start, checksum);
+	};
+
+	runTimerHeap("8-ary heap, scalar", heap_detail::MinChildKernel::Scalar, callbackPayload);
+	if (heap_detail::cpuHasAvx2()) {
+		runTimerHeap("8-ary heap, AVX2", heap_detail::MinChildKernel::Avx2, callbackPayload);
+	}
+	runTimerHeap("8-ary heap, scalar, pointer payloads", heap_detail::MinChildKernel::Scalar, pointerPayload);
+	if (heap_detail::cpuHasAvx2()) {
+		runTimerHeap("8-ary heap, AVX2, pointer payloads", heap_detail::MinChildKernel::Avx2, pointerPayload);
+	}
+
+	{
+		// Same deadlines at 1us resolution, the epoch follows the pops like it follows the clock. The
+		// payloads are the pointers of the runs above, so only the deadline width differs.
+		CompactTimerHeap<TestTimer *> heap{ 1'000, 0 };
+		heap.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			heap.push(deadlines[i], &payloads[i]);
+		}
+
+		std::int64_t checksum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while (!heap.empty()) {
+			checksum ^= heap.topDeadline();
+			heap.advance(heap.topDeadline());
+			heap.pop();
+		}
+		report("8-ary heap, 32-bit ticks, pointer payloads", std::chrono::steady_clock::now() - start, checksum);
+	}
+}
+
+#if defined(TIMERS_HAS_POSIX)
+// Durable inserts per second from a few producers, each insert waits for its group commit
+void benchmarkDurableInserts() {
+	constexpr int producers = 8;
+	constexpr int insertsPerProducer = 2'000;
+
+	const std::filesystem::path logPath = std::filesystem::temp_directory_path() / "timers-bench.wal";
+	std::filesystem::remove(logPath);
+	std::filesystem::remove(logPath.string() + ".snapshot");
+
+	std::chrono::steady_clock::duration elapsed{};
+	std::uint64_t syncs = 0;
+
+	{
+		TimersManager timers;
+		timers.registerCallbackType(1, [](std::string_view) -> TimersManager::TimerCallback { return [] {}; });
+		timers.openDurableLog(logPath, DurableTimerLog::Options{ .compactionThreshold = 4'096 });
+
+		const auto start = std::chrono::steady_clock::now();
+		{
+			std::vector<std::jthread> threads;
+			for (int p = 0; p < producers; ++p) {
+				threads.emplace_back([&timers] {
+					for (int i = 0; i < insertsPerProducer; ++i) {
+						timers.insertPersistentTimer(1, "lease", 1h);
+					}
+				});
+			}
+		}
+		elapsed = std::chrono::steady_clock::now() - start;
+		syncs = timers.durableLogSyncs();
+	}
+
+	const double seconds = std::chrono::duration<double>(elapsed).count();
+	std::cout << "durable inserts: " << producers * insertsPerProducer / seconds << " inserts/s, " << syncs << " fsyncs\n";
+
+	std::filesystem::remove(logPath);
+	std::filesystem::remove(logPath.string() + ".snapshot");
+}
+#endif
+
+struct ReplayReport {
+	std::size_t inserted{ 0 };
+	std::size_t cancelled{ 0 };
+	// Inserts turned away by the manager's admission control, they never fire
+	std::size_t rejected{ 0 };
+	std::size_t fired{ 0 };
+	// Fires in the recording, differs from fired when the replayed cancels won or lost other races
+	std::size_t recordedFires{ 0 };
+	std::chrono::steady_clock::duration elapsed{};
+	// Inserts and cancels issued per second
+	double operationsPerSecond{ 0 };
+	std::chrono::nanoseconds meanLateness{ 0 };
+	std::chrono::nanoseconds p99Lateness{ 0 };
+	std::chrono::nanoseconds maxLateness{ 0 };
+};
+
+// Drives a manager, or anything with insertTimer(cb, timeout) and cancelTimer(id), with a recorded
+// workload. At full speed the inserts and cancels are issued back to back, the timeouts stay as
+// recorded. Waits for every replayed timer to fire, be cancelled or, for handles with valid(), be
+// rejected.
+template <typename Manager>
+ReplayReport replayWorkload(const std::vector<WorkloadRecorder::Record> &records, Manager &manager, bool fullSpeed) {
+	using TimerHandle = decltype(manager.insertTimer(std::declval<TimersManager::TimerCallback>(), std::chrono::nanoseconds{}));
+
+	std::uint32_t timerCount = 0;
+	for (const auto &record : records) {
+		if (record.event == WorkloadRecorder::Event::Insert) {
+			timerCount = std::max(timerCount, record.timer + 1);
+		}
+	}
+
+	// Backends taking a priority get the recorded one, the lanes change which due timer goes first
+	const auto insert = [&manager](TimersManager::TimerCallback cb, std::chrono::nanoseconds delay, std::uint8_t recordedPriority) {
+		const auto priority = static_cast<TimersManager::Priority>(recordedPriority);
+		if constexpr (requires { manager.insertTimer(std::move(cb), delay, TimersManager::NoGroup, priority); }) {
+			return manager.insertTimer(std::move(cb), delay, TimersManager::NoGroup, priority);
+		}
+		else if constexpr (requires { manager.insertTimer(std::move(cb), delay, priority); }) {
+			return manager.insertTimer(std::move(cb), delay, priority);
+		}
+		else {
+			return manager.insertTimer(std::move(cb), delay);
+		}
+	};
+
+	std::vector<TimerHandle> handles(timerCount);
+	std::vector<std::int64_t> lateness(timerCount, -1);
+	std::atomic<std::size_t> fired{ 0 };
+	ReplayReport report;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto &record : records) {
+		if (!fullSpeed) {
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds{ record.time });
+		}
+
+		switch (record.event) {
+		case WorkloadRecorder::Event::Insert: {
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds{ record.delay };
+			handles[record.timer] = insert([&lateness, &fired, deadline, timer = record.timer] {
+				lateness[timer] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - deadline).count();
+				fired.fetch_add(1, std::memory_order_release);
+			}, std::chrono::nanoseconds{ record.delay }, record.priority);
+			++report.inserted;
+			// Handles without valid() come from backends without admission control
+			if constexpr (requires { handles[record.timer].valid(); }) {
+				if (!handles[record.timer].valid()) {
+					++report.rejected;
+				}
+			}
+			break;
+		}
+		case WorkloadRecorder::Event::Cancel:
+			if (record.timer < timerCount && manager.cancelTimer(handles[record.timer])) {
+				++report.cancelled;
+			}
+			break;
+		case WorkloadRecorder::Event::Fire:
+			++report.recordedFires;
+			break;
+		}
+	}
+	const auto issued = std::chrono::steady_clock::now() - start;
+
+	while (fired.load(std::memory_order_acquire) + report.cancelled + report.rejected < report.inserted) {
+		std::this_thread::sleep_for(1ms);
+	}
+	report.elapsed = std::chrono::steady_clock::now() - start;
+	report.fired = fired.load(std::memory_order_acquire);
+	report.operationsPerSecond = static_cast<double>(report.inserted + report.cancelled) / std::max(std::chrono::duration<double>(issued).count(), 1e-9);
+
+	std::vector<std::int64_t> fires;
+	for (const std::int64_t late : lateness) {
+		if (late >= 0) {
+			fires.push_back(late);
+		}
+	}
+
+	if (!fires.empty()) {
+		std::sort(fires.begin(), fires.end());
+		std::int64_t total = 0;
+		for (const std::int64_t late : fires) {
+			total += late;
+		}
+		report.meanLateness = std::chrono::nanoseconds{ total / static_cast<std::int64_t>(fires.size()) };
+		report.p99Lateness = std::chrono::nanoseconds{ fires[(fires.size() - 1) * 99 / 100] };
+		report.maxLateness = std::chrono::nanoseconds{ fires.back() };
+	}
+
+	return report;
+}
+
+void printReplayReport(const ReplayReport &report) {
+	const auto micros = [](std::chrono::nanoseconds duration) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	};
+
+	std::cout << "replayed " << report.inserted << " inserts (" << report.rejected << " rejected), " << report.cancelled << " cancels, " << report.fired << " fires ("
+		<< report.recordedFires << " recorded) in " << std::chrono::duration_cast<std::chrono::milliseconds>(report.elapsed).count() << "ms\n"
+		<< "throughput: " << report.operationsPerSecond << " ops/s\n"
+		<< "lateness: mean " << micros(report.meanLateness) << "us, p99 " << micros(report.p99Lateness) << "us, max " << micros(report.maxLateness) << "us\n";
+}
+
+// Minimal fire-and-forget coroutine type to show the awaitable timers
+struct DetachedTask {
+	struct promise_type {
+		DetachedTask get_return_object() {
+			return {};
+		}
+
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept {
+			return {};
+		}
+
+		void return_void() {}
+
+		void unhandled_exception() {
+			std::terminate();
+		}
+	};
+};
+
+DetachedTask sleepingCoroutine(TimersManager &timers) {
+	TestTimer timer;
+
+	co_await timers.sleepFor(1500ms);
+	timer();
+
+	co_await timers.sleepUntil(std::chrono::steady_clock::now() + 750ms);
+	timer();
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && std::string_view{ argv[1] } == "--bench") {
+		benchmarkHeapPop();
+#if defined(TIMERS_HAS_POSIX)
+		benchmarkDurableInserts();
+#endif
+		return 0;
+	}
+
+	// main --replay <file> [--full-speed]
+	if (argc > 2 && std::string_view{ argv[1] } == "--replay") {
+		const auto records = WorkloadRecorder::load(argv[2]);
+		TimersManager replayTimers;
+		printReplayReport(replayWorkload(records, replayTimers, argc > 3 && std::string_view{ argv[3] } == "--full-speed"));
+		return 0;
+	}
+
+	// main --record <file> runs the demo and records its timers
+	TimersManager::Options options{ .shutdownPolicy = TimersManager::ShutdownPolicy::RunDue, .workerName = "timers-demo" };
+	if (argc > 2 && std::string_view{ argv[1] } == "--record") {
+		options.recorder = std::make_shared<WorkloadRecorder>(argv[2]);
+	}
+
+	TimersManager timers{ options };
 
 	timers.insertTimer(TestTimer{}, 3s);
 	timers.insertTimer(TestTimer{}, 2s);
@@ -176,9 +5401,110 @@ int main() {
 	timers.insertTimer(TestTimer{}, 5.5s);
 	timers.insertTimer(TestTimer{}, 500ms);
 	timers.insertTimer(RepeatingTimer{ timers, TestTimer{}, 1s }, 4s);
+	sleepingCoroutine(timers);
+
+	auto answer = timers.scheduleAfter([] { return 42; }, 250ms);
+	timers.scheduleAfter([] { std::cout << "Abandoned task ran\n"; }, 100ms);
+	std::cout << "Scheduled task returned " << answer.get() << "\n";
+
+	timers.withTimeout([&timers](TimersManager::TimeoutCompletion done) {
+		// Simulated asynchronous operation finishing before its deadline
+		timers.insertTimer([done]() mutable {
+			std::cout << (done.complete() ? "Operation completed in time\n" : "Operation completed too late\n");
+		}, 200ms);
+	}, 1s, [] { std::cout << "Operation timed out\n"; });
+
+	RetryBudget backendBudget;
+	RetryScheduler flakyRequest{ timers, RetryPolicy{}, backendBudget,
+		[](unsigned attempt) {
+			std::cout << "Attempt " << attempt << "\n";
+			return attempt == 3;
+		},
+		[](bool succeeded, unsigned attempts) {
+			std::cout << (succeeded ? "Succeeded" : "Gave up") << " after " << attempts << " attempts\n";
+		}
+	};
+	flakyRequest.start();
+
+	Debouncer configReload{ timers, 300ms, [] { std::cout << "Config reloaded\n"; } };
+	Throttler metricsFlush{ timers, 200ms, [] { std::cout << "Metrics flushed\n"; } };
+	for (int i = 0; i < 100'000; ++i) {
+		configReload.trigger();
+		metricsFlush.trigger();
+	}
+
+	const TimersManager::GroupId session = timers.createGroup();
+	for (int i = 0; i < 10; ++i) {
+		timers.insertTimer([] { std::cout << "Session timer leaked\n"; }, 1s + i * 100ms, session);
+	}
+	std::cout << "Session closed, cancelled " << timers.cancelGroup(session) << " timers\n";
+
+	for (int i = 0; i < 3; ++i) {
+		timers.insertTimer([] { std::cout << "Cache entry expired\n"; }, 600ms, TimersManager::NoGroup, TimersManager::Priority::Low);
+	}
+	timers.insertTimer([] { std::cout << "Heartbeat sent\n"; }, 600ms, TimersManager::NoGroup, TimersManager::Priority::High);
+
+#if defined(TIMERS_HAS_POSIX)
+	const auto makeLogTimer = [](std::string_view payload) -> TimersManager::TimerCallback {
+		return [message = std::string{ payload }] { std::cout << message << "\n"; };
+	};
+	const std::filesystem::path snapshotPath = std::filesystem::temp_directory_path() / "timers.snapshot";
+
+	timers.registerCallbackType(1, makeLogTimer);
+	timers.insertPersistentTimer(1, "Persistent timer fired", 800ms);
+	std::cout << "Saved " << timers.saveSnapshot(snapshotPath) << " timers to " << snapshotPath << "\n";
+
+	TimersManager restoredTimers;
+	restoredTimers.registerCallbackType(1, makeLogTimer);
+	std::cout << "Restored " << restoredTimers.restoreSnapshot(snapshotPath) << " timers\n";
+#endif
+
+	timers.insertTimerAt([] { std::cout << "Wall clock timer fired\n"; }, std::chrono::system_clock::now() + 700ms);
+
+	CronJob everyMinute{ timers, CronSchedule::parse("* * * * *"), [] { std::cout << "Cron job ran\n"; } };
+	const std::time_t nextRun = std::chrono::system_clock::to_time_t(everyMinute.nextOccurrence());
+	std::cout << "Cron job scheduled for " << std::ctime(&nextRun);
+
+#if defined(TIMERS_HAS_LINUX)
+	// Normally the service and its clients live in different processes
+	SharedTimerService hostTimers{ "/timers-demo-" + std::to_string(::getpid()) };
+	SharedTimerClient hostClient{ "/timers-demo-" + std::to_string(::getpid()) };
+	hostClient.insertTimer([] { std::cout << "Shared memory timer fired\n"; }, 300ms);
+#endif
+
+	RateLimiter<std::string_view> outbound{ timers, 4.0, 2.0 };
+	for (int i = 0; i < 5; ++i) {
+		outbound.acquire("tenant-a", [i, sent = TestTimer{}]() mutable {
+			std::cout << "Request " << i << " sent, ";
+			sent();
+		});
+	}
+
+	timers.insertTimer([&timers] {
+		const TimersManager::Statistics stats = timers.statistics();
+		std::cout << "Timers pending " << stats.pending << ", fired " << stats.fired << ", cancelled " << stats.cancelled
+			<< ", wakeups " << stats.wakeups << " (" << stats.spuriousWakeups << " spurious), lock wait "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(stats.lockWaitTime).count() << "us\n";
+	}, 6s);
+
+	TimersManager watchedTimers{ TimersManager::Options{ .callbackBudget = 100ms, .failoverOnSlowCallback = true, .traceCapacity = 1024 } };
+	watchedTimers.insertTimer([] { std::this_thread::sleep_for(400ms); }, 0ms);
+	watchedTimers.insertTimer([] { std::cout << "Timer fired while the worker was stuck\n"; }, 200ms);
+
+	TimersManager boundedTimers{ TimersManager::Options{ .maxTimers = 2, .admissionPolicy = TimersManager::AdmissionPolicy::DropFarthest } };
+	boundedTimers.insertTimer([] { std::cout << "Near bounded timer fired\n"; }, 100ms);
+	boundedTimers.insertTimer([] { std::cout << "Far bounded timer fired\n"; }, 10s);
+	const auto bounded = boundedTimers.insertTimer([] { std::cout << "Middle bounded timer fired\n"; }, 200ms);
+	std::cout << "Bounded timer " << (bounded.admission() == TimersManager::Admission::AdmittedByDropping ? "admitted by dropping the farthest" : "not admitted") << "\n";
 
 	char c;
 	std::cin >> c;
 
+	const std::filesystem::path tracePath = std::filesystem::temp_directory_path() / "timers-trace.json";
+	std::ofstream traceFile{ tracePath };
+	if (watchedTimers.writeChromeTrace(traceFile)) {
+		std::cout << "Trace written to " << tracePath << "\n";
+	}
+
 	return 0;
 }